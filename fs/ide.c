@@ -13,16 +13,28 @@
  */
 static uint8_t wait_ide_ready() {
 	uint8_t flag;
+	u_int spins = 0;
 	while (1) {
 		panic_on(syscall_read_dev(&flag, MALTA_IDE_STATUS, 1));
 		if ((flag & MALTA_IDE_BUSY) == 0) {
 			break;
 		}
-		syscall_yield();
+		backoff(&spins);
 	}
 	return flag;
 }
 
+/* Overview:
+ *   Queue the write of the byte at 'val' to the device register 'dev'.
+ *
+ * Hint:
+ *   The register writes of a request are run together by 'submit_flush', and so are the data
+ *   transfers of a sector, so that a sector takes a few syscalls rather than one per word.
+ */
+static void ide_write_reg(uint8_t *val, u_int dev) {
+	panic_on(submit_add(SYS_write_dev, (u_int)val, dev, 1, 0, 0));
+}
+
 /* Overview:
  *  read data from IDE disk. First issue a read request through
  *  disk register and then copy data from disk buffer
@@ -41,7 +53,7 @@ static uint8_t wait_ide_ready() {
  * Hint: Use the physical address and offsets defined in 'include/malta.h'.
  */
 void ide_read(u_int diskno, u_int secno, void *dst, u_int nsecs) {
-	uint8_t temp;
+	uint8_t temp, regs[6];
 	u_int offset = 0, max = nsecs + secno;
 	panic_on(diskno >= 2);
 
@@ -49,37 +61,40 @@ void ide_read(u_int diskno, u_int secno, void *dst, u_int nsecs) {
 	while (secno < max) {
 		temp = wait_ide_ready();
 		// Step 1: Write the number of operating sectors to NSECT register
-		temp = 1;
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_NSECT, 1));
+		regs[0] = 1;
+		ide_write_reg(&regs[0], MALTA_IDE_NSECT);
 
 		// Step 2: Write the 7:0 bits of sector number to LBAL register
-		temp = secno & 0xff;
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_LBAL, 1));
+		regs[1] = secno & 0xff;
+		ide_write_reg(&regs[1], MALTA_IDE_LBAL);
 
 		// Step 3: Write the 15:8 bits of sector number to LBAM register
 		/* Exercise 5.3: Your code here. (1/9) */
-		temp = (secno >> 8) & 0xff;
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_LBAM, 1));
+		regs[2] = (secno >> 8) & 0xff;
+		ide_write_reg(&regs[2], MALTA_IDE_LBAM);
 		// Step 4: Write the 23:16 bits of sector number to LBAH register
 		/* Exercise 5.3: Your code here. (2/9) */
-		temp = (secno >> 16) & 0xff;
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_LBAH, 1));
+		regs[3] = (secno >> 16) & 0xff;
+		ide_write_reg(&regs[3], MALTA_IDE_LBAH);
 		// Step 5: Write the 27:24 bits of sector number, addressing mode
 		// and diskno to DEVICE register
-		temp = ((secno >> 24) & 0x0f) | MALTA_IDE_LBA | (diskno << 4);
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_DEVICE, 1));
+		regs[4] = ((secno >> 24) & 0x0f) | MALTA_IDE_LBA | (diskno << 4);
+		ide_write_reg(&regs[4], MALTA_IDE_DEVICE);
 
 		// Step 6: Write the working mode to STATUS register
-		temp = MALTA_IDE_CMD_PIO_READ;
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_STATUS, 1));
+		regs[5] = MALTA_IDE_CMD_PIO_READ;
+		ide_write_reg(&regs[5], MALTA_IDE_STATUS);
+		panic_on(submit_flush());
 
 		// Step 7: Wait until the IDE is ready
 		temp = wait_ide_ready();
 
 		// Step 8: Read the data from device
 		for (int i = 0; i < SECT_SIZE / 4; i++) {
-			panic_on(syscall_read_dev(dst + offset + i * 4, MALTA_IDE_DATA, 4));
+			panic_on(submit_add(SYS_read_dev, (u_int)dst + offset + i * 4, MALTA_IDE_DATA,
+					    4, 0, 0));
 		}
+		panic_on(submit_flush());
 
 		// Step 9: Check IDE status
 		panic_on(syscall_read_dev(&temp, MALTA_IDE_STATUS, 1));
@@ -105,7 +120,7 @@ void ide_read(u_int diskno, u_int secno, void *dst, u_int nsecs) {
  * Hint: Use the physical address and offsets defined in 'include/malta.h'.
  */
 void ide_write(u_int diskno, u_int secno, void *src, u_int nsecs) {
-	uint8_t temp;
+	uint8_t temp, regs[6];
 	u_int offset = 0, max = nsecs + secno;
 	panic_on(diskno >= 2);
 
@@ -114,37 +129,40 @@ void ide_write(u_int diskno, u_int secno, void *src, u_int nsecs) {
 		temp = wait_ide_ready();
 		// Step 1: Write the number of operating sectors to NSECT register
 		/* Exercise 5.3: Your code here. (3/9) */
-		temp = 1;
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_NSECT, 1));
+		regs[0] = 1;
+		ide_write_reg(&regs[0], MALTA_IDE_NSECT);
 		// Step 2: Write the 7:0 bits of sector number to LBAL register
 		/* Exercise 5.3: Your code here. (4/9) */
-		temp = secno & 0xff;
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_LBAL, 1));
+		regs[1] = secno & 0xff;
+		ide_write_reg(&regs[1], MALTA_IDE_LBAL);
 		// Step 3: Write the 15:8 bits of sector number to LBAM register
 		/* Exercise 5.3: Your code here. (5/9) */
-		temp = (secno >> 8) & 0xff;
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_LBAM, 1));
+		regs[2] = (secno >> 8) & 0xff;
+		ide_write_reg(&regs[2], MALTA_IDE_LBAM);
 		// Step 4: Write the 23:16 bits of sector number to LBAH register
 		/* Exercise 5.3: Your code here. (6/9) */
-		temp = (secno >> 16) & 0xff;
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_LBAH, 1));
+		regs[3] = (secno >> 16) & 0xff;
+		ide_write_reg(&regs[3], MALTA_IDE_LBAH);
 		// Step 5: Write the 27:24 bits of sector number, addressing mode
 		// and diskno to DEVICE register
 		/* Exercise 5.3: Your code here. (7/9) */
-		temp = ((secno >> 24) & 0x0f) | MALTA_IDE_LBA | (diskno << 4);
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_DEVICE, 1));
+		regs[4] = ((secno >> 24) & 0x0f) | MALTA_IDE_LBA | (diskno << 4);
+		ide_write_reg(&regs[4], MALTA_IDE_DEVICE);
 		// Step 6: Write the working mode to STATUS register
 		/* Exercise 5.3: Your code here. (8/9) */
-		temp = MALTA_IDE_CMD_PIO_WRITE;
-		panic_on(syscall_write_dev(&temp, MALTA_IDE_STATUS, 1));
+		regs[5] = MALTA_IDE_CMD_PIO_WRITE;
+		ide_write_reg(&regs[5], MALTA_IDE_STATUS);
+		panic_on(submit_flush());
 		// Step 7: Wait until the IDE is ready
 		temp = wait_ide_ready();
 
 		// Step 8: Write the data to device
 		for (int i = 0; i < SECT_SIZE / 4; i++) {
 			/* Exercise 5.3: Your code here. (9/9) */
-			panic_on(syscall_write_dev(src + offset + i * 4, MALTA_IDE_DATA, 4));
+			panic_on(submit_add(SYS_write_dev, (u_int)src + offset + i * 4,
+					    MALTA_IDE_DATA, 4, 0, 0));
 		}
+		panic_on(submit_flush());
 
 		// Step 9: Check IDE status
 		panic_on(syscall_read_dev(&temp, MALTA_IDE_STATUS, 1));
@@ -120,25 +120,50 @@ int open_lookup(u_int envid, u_int fileid, struct Open **po) {
  * Functions with the prefix "serve_" are those who
  * conduct the file system requests from clients.
  * The file system receives the requests by function
- * `ipc_recv`, when the requests are received, the
+ * `ipc_reply_wait`, when the requests are received, the
  * file system will call the corresponding `serve_`
- * and return the result to the caller by function
- * `ipc_send`.
+ * and set the result for the caller by function
+ * `serve_reply`. It is sent by the next `ipc_reply_wait`.
  */
 
+/*
+ * The reply to the request being served.
+ */
+static struct {
+	u_int envid; // the client to reply to, 0 if none
+	u_int val;
+	void *srcva;
+	u_int perm;
+	u_int npages; // if not 0, reply with the 'iov' instead of 'srcva'
+	struct Ipc_page iov[IPC_MAX_PAGES];
+} pending_reply;
+
+/*
+ * Overview:
+ *  Set the reply to the request of 'envid' being served: the value 'val',
+ *  together with the page at 'srcva' if it is not NULL.
+ */
+static void serve_reply(u_int envid, u_int val, void *srcva, u_int perm) {
+	pending_reply.envid = envid;
+	pending_reply.val = val;
+	pending_reply.srcva = srcva;
+	pending_reply.perm = perm;
+	pending_reply.npages = 0;
+}
+
 /*
  * Overview:
  * Serve to open a file specified by the path in `rq`.
  * It will try to alloc an open descriptor, open the file
  * and then save the info in the File descriptor. If everything
- * is done, it will use the ipc_send to return the FileFd page
+ * is done, it will use the serve_reply to return the FileFd page
  * to the caller.
  * Parameters:
  * envid: the id of the request process.
  * rq: the request, which contains the path and the open mode.
  * Return:
- * if Success, return the FileFd page to the caller by ipc_send,
- * Otherwise, use ipc_send to return the error value to the caller.
+ * if Success, return the FileFd page to the caller by serve_reply,
+ * Otherwise, use serve_reply to return the error value to the caller.
  */
 void serve_open(u_int envid, struct Fsreq_open *rq) {
 	struct File *f;
@@ -148,19 +173,19 @@ void serve_open(u_int envid, struct Fsreq_open *rq) {
 
 	// Find a file id.
 	if ((r = open_alloc(&o)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	if ((rq->req_omode & O_CREAT) && (r = file_create(rq->req_path, &f)) < 0 &&
 	    r != -E_FILE_EXISTS) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	// Open the file.
 	if ((r = file_open(rq->req_path, &f)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
@@ -170,7 +195,8 @@ void serve_open(u_int envid, struct Fsreq_open *rq) {
 	// If mode include O_TRUNC, set the file size to 0
 	if (rq->req_omode & O_TRUNC) {
 		if ((r = file_set_size(f, 0)) < 0) {
-			ipc_send(envid, r, 0, 0);
+			serve_reply(envid, r, 0, 0);
+			return;
 		}
 	}
 
@@ -181,7 +207,7 @@ void serve_open(u_int envid, struct Fsreq_open *rq) {
 	o->o_mode = rq->req_omode;
 	ff->f_fd.fd_omode = o->o_mode;
 	ff->f_fd.fd_dev_id = devfile.dev_id;
-	ipc_send(envid, 0, o->o_ff, PTE_D | PTE_LIBRARY);
+	serve_reply(envid, 0, o->o_ff, PTE_D | PTE_LIBRARY);
 }
 
 /*
@@ -189,33 +215,47 @@ void serve_open(u_int envid, struct Fsreq_open *rq) {
  *  Serve to map the file specified by the fileid in `rq`.
  *  It will use the fileid and envid to find the open file and
  *  then call the `file_get_block` to get the block and use
- *  the `ipc_send` to return the block to the caller.
+ *  the `serve_reply` to return the block to the caller.
  * Parameters:
  *  envid: the id of the request process.
  *  rq: the request, which contains the fileid and the offset.
  * Return:
- *  if Success, use ipc_send to return zero and  the block to
+ *  if Success, use serve_reply to return zero and  the block to
  *  the caller.Otherwise, return the error value to the caller.
  */
 void serve_map(u_int envid, struct Fsreq_map *rq) {
 	struct Open *pOpen;
-	u_int filebno;
+	u_int filebno, i;
 	void *blk;
 	int r;
 
 	if ((r = open_lookup(envid, rq->req_fileid, &pOpen)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	filebno = rq->req_offset / BLOCK_SIZE;
 
-	if ((r = file_get_block(pOpen->o_file, filebno, &blk)) < 0) {
-		ipc_send(envid, r, 0, 0);
+	if (rq->req_nblocks > IPC_MAX_PAGES) {
+		serve_reply(envid, -E_INVAL, 0, 0);
 		return;
 	}
 
-	ipc_send(envid, 0, blk, PTE_D | PTE_LIBRARY);
+	// Several blocks are sent with a single reply into the window of the caller's ipc_callv.
+	for (i = 0; i < rq->req_nblocks || i == 0; i++) {
+		if ((r = file_get_block(pOpen->o_file, filebno + i, &blk)) < 0) {
+			serve_reply(envid, r, 0, 0);
+			return;
+		}
+		pending_reply.iov[i].srcva = (u_int)blk;
+		pending_reply.iov[i].dstoff = i * BLOCK_SIZE;
+		pending_reply.iov[i].perm = PTE_D | PTE_LIBRARY;
+	}
+
+	serve_reply(envid, 0, blk, PTE_D | PTE_LIBRARY);
+	if (rq->req_nblocks > 1) {
+		pending_reply.npages = i;
+	}
 }
 
 /*
@@ -227,23 +267,23 @@ void serve_map(u_int envid, struct Fsreq_map *rq) {
  *  envid: the id of the request process.
  *  rq: the request, which contains the fileid and the size.
  * Return:
- * if Success, use ipc_send to return 0 to the caller. Otherwise,
+ * if Success, use serve_reply to return 0 to the caller. Otherwise,
  * return the error value to the caller.
  */
 void serve_set_size(u_int envid, struct Fsreq_set_size *rq) {
 	struct Open *pOpen;
 	int r;
 	if ((r = open_lookup(envid, rq->req_fileid, &pOpen)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	if ((r = file_set_size(pOpen->o_file, rq->req_size)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
-	ipc_send(envid, 0, 0, 0);
+	serve_reply(envid, 0, 0, 0);
 }
 
 /*
@@ -255,7 +295,7 @@ void serve_set_size(u_int envid, struct Fsreq_set_size *rq) {
  *  envid: the id of the request process.
  * 	rq: the request, which contains the fileid.
  * Return:
- *  if Success, use ipc_send to return 0 to the caller.Otherwise,
+ *  if Success, use serve_reply to return 0 to the caller.Otherwise,
  *  return the error value to the caller.
  */
 void serve_close(u_int envid, struct Fsreq_close *rq) {
@@ -264,33 +304,33 @@ void serve_close(u_int envid, struct Fsreq_close *rq) {
 	int r;
 
 	if ((r = open_lookup(envid, rq->req_fileid, &pOpen)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	file_close(pOpen->o_file);
-	ipc_send(envid, 0, 0, 0);
+	serve_reply(envid, 0, 0, 0);
 }
 
 /*
  * Overview:
  *  Serve to remove a file specified by the path in `req`.
  *  It calls the `file_remove` to remove the file and then use
- *  the `ipc_send` to return the result to the caller.
+ *  the `serve_reply` to return the result to the caller.
  * Parameters:
  *  envid: the id of the request process.
  *  rq: the request, which contains the path.
  * Return:
- *  the result of the file_remove to the caller by ipc_send.
+ *  the result of the file_remove to the caller by serve_reply.
  */
 void serve_remove(u_int envid, struct Fsreq_remove *rq) {
 	// Step 1: Remove the file specified in 'rq' using 'file_remove' and store its return value.
 	int r;
 	/* Exercise 5.11: Your code here. (1/2) */
 	r = file_remove(rq->req_path);
-	// Step 2: Respond the return value to the caller 'envid' using 'ipc_send'.
+	// Step 2: Respond the return value to the caller 'envid' using 'serve_reply'.
 	/* Exercise 5.11: Your code here. (2/2) */
-	ipc_send(envid, r, 0, 0);
+	serve_reply(envid, r, 0, 0);
 }
 
 /*
@@ -302,7 +342,7 @@ void serve_remove(u_int envid, struct Fsreq_remove *rq) {
  *  envid: the id of the request process.
  *  rq: the request, which contains the fileid and the offset.
  * `Return`:
- *  if Success, use ipc_send to return 0 to the caller. Otherwise,
+ *  if Success, use serve_reply to return 0 to the caller. Otherwise,
  *  return the error value to the caller.
  */
 void serve_dirty(u_int envid, struct Fsreq_dirty *rq) {
@@ -310,39 +350,39 @@ void serve_dirty(u_int envid, struct Fsreq_dirty *rq) {
 	int r;
 
 	if ((r = open_lookup(envid, rq->req_fileid, &pOpen)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
 	if ((r = file_dirty(pOpen->o_file, rq->req_offset)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 
-	ipc_send(envid, 0, 0, 0);
+	serve_reply(envid, 0, 0, 0);
 }
 
 /*
  * Overview:
  *  Serve to sync the file system.
  *  it calls the `fs_sync` to sync the file system.
- *  and then use the `ipc_send` and `return` 0 to tell the caller
+ *  and then use the `serve_reply` and `return` 0 to tell the caller
  *  file system is synced.
  */
 void serve_sync(u_int envid) {
 	fs_sync();
-	ipc_send(envid, 0, 0, 0);
+	serve_reply(envid, 0, 0, 0);
 }
 
 void serve_create(u_int envid, struct Fsreq_create *rq) {
 	int r;
 	struct File *file;
 	if((r = file_create(rq->req_path, &file)) < 0) {
-		ipc_send(envid, r, 0, 0);
+		serve_reply(envid, r, 0, 0);
 		return;
 	}
 	file->f_type = rq->type;
-	ipc_send(envid, 0, 0, 0);
+	serve_reply(envid, 0, 0, 0);
 }
 
 /*
@@ -366,12 +406,33 @@ void *serve_table[MAX_FSREQNO] = {
  */
 void serve(void) {
 	u_int req, whom, perm;
+	u_int words[IPC_MSG_WORDS];
 	void (*func)(u_int, u_int);
 
 	for (;;) {
 		perm = 0;
 
-		req = ipc_recv(&whom, (void *)REQVA, &perm);
+		// Reply to the last request (if any) and receive the next one in a single syscall.
+		if (pending_reply.npages != 0) {
+			req = ipc_replyv_wait(pending_reply.envid, pending_reply.val,
+					      pending_reply.iov, pending_reply.npages, &whom,
+					      (void *)REQVA, &perm);
+		} else {
+			req = ipc_reply_wait(pending_reply.envid, pending_reply.val,
+					     pending_reply.srcva, pending_reply.perm, 0, &whom,
+					     (void *)REQVA, &perm);
+		}
+		pending_reply.envid = 0;
+
+		// Small requests come in message words: no argument page to unmap.
+		if (req < MAX_FSREQNO && (FSREQ_WORDS & (1 << req))) {
+			memset(words, 0, sizeof(words));
+			memcpy(words, (const void *)env->env_ipc_msg.words,
+			       env->env_ipc_msg.len * sizeof(u_int));
+			func = serve_table[req];
+			func(whom, (u_int)words);
+			continue;
+		}
 
 		// All requests must contain an argument page
 		if (!(perm & PTE_V)) {
@@ -0,0 +1,26 @@
+#ifndef _CHAN_H_
+#define _CHAN_H_
+
+#include <types.h>
+
+/*
+ * A channel is a set of pages shared by two envs: the env creating it and a peer chosen at
+ * creation, which maps the same pages with 'sys_chan_attach'. The kernel only owns the pages;
+ * what is kept in them (a ring buffer in 'user/lib/chan.c') is up to the envs.
+ */
+#define NCHAN 64	  // channels in the system
+#define CHAN_MAX_PAGES 16 // pages in a channel
+
+#ifndef __ASSEMBLER__
+
+struct Env;
+
+int channel_create(struct Env *e, struct Env *peer, u_int npages, u_int va);
+int channel_npages(struct Env *e, int chanid);
+int channel_attach(struct Env *e, int chanid, u_int va);
+int channel_peer(struct Env *e, int chanid, u_int *peer);
+int channel_detach(struct Env *e, int chanid);
+void channel_release(struct Env *e);
+
+#endif /* __ASSEMBLER__ */
+#endif
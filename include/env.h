@@ -10,29 +10,96 @@
 #define NENV (1 << LOG2NENV)
 #define ENVX(envid) ((envid) & (NENV - 1))
 
+// Number of feedback levels of the multi-level feedback queue scheduler.
+#define NSCHED_LEVEL 8
+
 // All possible values of 'env_status' in 'struct Env'.
 #define ENV_FREE 0
 #define ENV_RUNNABLE 1
 #define ENV_NOT_RUNNABLE 2
 
+TAILQ_HEAD(Env_wait_list, Env);
+
+// Maximum number of words carried by an IPC message besides its value (see 'sys_ipc_send').
+#define IPC_MSG_WORDS 8
+
+// Message words of an IPC message, copied by the kernel so that small messages need no page.
+struct Ipc_msg {
+	u_int len; // number of words used in 'words'
+	u_int words[IPC_MSG_WORDS];
+};
+
+// Maximum number of pages transferred by a single IPC message (see 'sys_ipc_sendv').
+#define IPC_MAX_PAGES 16
+
+// Notification bits any env may post to any other (see 'sys_notify'). The library wakes up the
+// ends of pipes and channels with them, and those re-check their condition when woken up.
+#define NOTIFY_ANY 0xc0000000
+
+// A page sent with an IPC message: the page mapped at 'srcva' in the sender (none if 0) is mapped
+// at offset 'dstoff' in the receive window of the receiver, with 'perm'.
+struct Ipc_page {
+	u_int srcva;
+	u_int dstoff;
+	u_int perm;
+};
+
 // Control block of an environment (process).
 struct Env {
 	struct Trapframe env_tf;	 // saved context (registers) before switching
 	LIST_ENTRY(Env) env_link;	 // intrusive entry in 'env_free_list'
 	u_int env_id;			 // unique environment identifier
-	u_int env_asid;			 // ASID of this env
+	u_int env_asid;			 // ASID of this env, tagged with its generation
 	u_int env_parent_id;		 // env_id of this env's parent
 	u_int env_status;		 // status of this env
 	Pde *env_pgdir;			 // page directory
 	TAILQ_ENTRY(Env) env_sched_link; // intrusive entry in 'env_sched_list'
 	u_int env_pri;			 // schedule priority
 
+	// Multi-level feedback queue state
+	u_int env_sched_level; // feedback level, 0 is the highest
+	u_int env_sched_ticks; // ticks left at this level before being demoted
+	u_int env_sched_epoch; // boost epoch in which 'env_sched_level' was set
+
+	// Stride scheduling state
+	u_int env_stride_pass; // virtual time consumed, advanced by 'STRIDE1 / env_pri' per tick
+
+	// Adaptive time slice (see 'sched_adapt')
+	u_int env_quantum_order; // our time slice lasts 'SCHED_QUANTUM_MIN << env_quantum_order'
+
+	// Blocking
+	TAILQ_ENTRY(Env) env_wait_link;	    // intrusive entry in the wait list we are blocked on
+	struct Env_wait_list *env_wait_list; // the wait list we are blocked on, or NULL
+	LIST_ENTRY(Env) env_timer_link;	    // intrusive entry in the timer wheel
+	u_int env_timer_expire;		    // tick at which our timer expires
+	u_int env_timer_armed;		    // whether our timer is in the timer wheel
+
 	// Lab 4 IPC
-	u_int env_ipc_value;   // the value sent to us
-	u_int env_ipc_from;    // envid of the sender
-	u_int env_ipc_recving; // whether this env is blocked receiving
-	u_int env_ipc_dstva;   // va at which the received page should be mapped
-	u_int env_ipc_perm;    // perm in which the received page should be mapped
+	u_int env_ipc_value;     // the value sent to us
+	u_int env_ipc_from;      // envid of the sender
+	u_int env_ipc_recving;   // whether this env is blocked receiving
+	u_int env_ipc_recv_from; // if not 0, the only env we receive from (the callee of our call)
+	u_int env_ipc_dstva;     // va at which the received page should be mapped
+	u_int env_ipc_perm;      // perm in which the received page should be mapped
+	u_int env_ipc_handoff;   // receiver we woke up last, to switch to if we block right after
+	u_int env_ipc_dstpages;  // pages in the receive window at 'env_ipc_dstva'
+	u_int env_ipc_npages;    // number of pages received with the last message
+
+	struct Ipc_msg env_ipc_msg; // the message words sent to us
+
+	// Blocking IPC send
+	struct Env_wait_list env_ipc_senders; // senders blocked until we receive, in FIFO order
+	u_int env_ipc_out_value;	      // the value we are blocked sending
+	u_int env_ipc_out_npages;	      // entries used in 'env_ipc_out_pages'
+	struct Ipc_msg env_ipc_out_msg;	      // the message words we are (blocked) sending
+	u_int env_ipc_calling;		      // whether we then wait for the reply of the receiver
+	struct Env_wait_list env_ipc_callers; // callers blocked waiting for our reply
+
+	struct Ipc_page env_ipc_out_pages[IPC_MAX_PAGES]; // the pages we are (blocked) sending
+
+	// Notifications (see 'sys_notify')
+	u_int env_notify_bits; // bits posted to us and not taken yet
+	u_int env_notify_mask; // bits we are blocked waiting for, 0 if not waiting
 
 	// Lab 4 fault handling
 	u_int env_user_tlb_mod_entry; // userspace TLB Mod handler
@@ -40,6 +107,16 @@ struct Env {
 	// Lab 6 scheduler counts
 	u_int env_runs; // number of times we've been env_run'ed
 
+	// CPU time accounting, in CPU cycles (see 'kern/kclock.c')
+	uint64_t env_utime;    // time spent in user mode
+	uint64_t env_ktime;    // time spent in the kernel on our behalf
+	u_int env_syscalls;    // number of syscalls made
+	u_int env_nvcsw;       // voluntary context switches (yielded or blocked)
+	u_int env_nivcsw;      // involuntary context switches (preempted)
+	u_int env_nintr;       // timer interrupts taken while running
+	u_int env_tlb_refills; // TLB misses taken (refills and invalid entries)
+	u_int env_cow_faults;  // copy-on-write faults resolved by the kernel (see 'do_tlb_mod')
+
 	// shell id 用于环境变量权限判断
     int env_shell_id;
 	/* 本环境自己的环境变量链表 */
@@ -49,7 +126,7 @@ struct Env {
 LIST_HEAD(Env_list, Env);
 TAILQ_HEAD(Env_sched_list, Env);
 extern struct Env *curenv;		     // the current env
-extern struct Env_sched_list env_sched_list; // runnable env list
+extern struct Env_sched_list env_sched_list[NSCHED_LEVEL]; // runnable env lists
 
 extern char cur_path[128]; // current working directory path
 
@@ -99,4 +176,7 @@ int envvar_getall(struct Env *env, char *buf, int bufsize);
 
 /* 当父进程创建子进程时，只复制父进程中 owner==0 的全局变量到子进程 */
 void env_copy_vars(struct Env *child, struct Env *parent);
+
+/* 进程销毁时释放其所有环境变量 */
+void env_free_vars(struct Env *e);
 #endif // !_ENV_H_
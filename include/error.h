@@ -44,6 +44,9 @@
 // File not a valid executable
 #define E_NOT_EXEC 13
 
+// Timed wait expired before the event happened
+#define E_TIMEOUT 14
+
 /*
  * A quick wrapper around function calls to propagate errors.
  * Use this with caution, as it leaks resources we've acquired so far.
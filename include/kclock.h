@@ -1,24 +1,61 @@
 #ifndef _KCLOCK_H_
 #define _KCLOCK_H_
 
-#include <asm/asm.h>
-
 #define TIMER_INTERVAL (500000) // WARNING: DO NOT MODIFY THIS LINE!
 
+// CP0_COMPARE is never armed closer than this many cycles ahead of CP0_COUNT, so that the timer
+// interrupt cannot be lost by arming it in the past.
+#define KCLOCK_MIN_DELTA 2000
+
+#ifdef __ASSEMBLER__
+#include <asm/asm.h>
+
 // clang-format off
 .macro RESET_KCLOCK
-	li 	t0, TIMER_INTERVAL
 	/*
-	 * Hint:
-	 *   Use 'mtc0' to write an appropriate value into the CP0_COUNT and CP0_COMPARE registers.
-	 *   Writing to the CP0_COMPARE register will clear the timer interrupt.
-	 *   The CP0_COUNT register increments at a fixed frequency. When the values of CP0_COUNT and
-	 *   CP0_COMPARE registers are equal, the timer interrupt will be triggered.
-	 *
+	 * CP0_COUNT runs freely and is never written: it is the time base of 'kern/kclock.c'. We
+	 * arm the timer interrupt at 'kclock_compare' (the next tick, the end of the time slice, or
+	 * the next wakeup when idle), or 'KCLOCK_MIN_DELTA' cycles from now if that point has
+	 * already passed.
+	 * Writing to the CP0_COMPARE register clears the pending timer interrupt.
 	 */
-	/* Exercise 3.11: Your code here. */
-	mtc0 zero, CP0_COUNT
-	mtc0 t0, CP0_COMPARE
+	lw      t0, kclock_compare
+	mfc0    t1, CP0_COUNT
+	subu    t2, t0, t1
+	addiu   t2, t2, -KCLOCK_MIN_DELTA
+	bgtz    t2, 1f
+	addiu   t0, t1, KCLOCK_MIN_DELTA
+1:
+	mtc0    t0, CP0_COMPARE
 .endm
 // clang-format on
+
+#else
+
+#include <types.h>
+
+struct Env;
+
+extern u_int kclock_compare;
+extern u_int kclock_jiffies;
+
+uint64_t kclock_cycles(void);
+void kclock_update(void);
+int kclock_pending(void);
+void kclock_set_idle(int poll);
+void kclock_arm(struct Env *e, u_int ticks);
+void kclock_cancel(struct Env *e);
+void kclock_enter_kernel(void);
+void kclock_leave_kernel(void);
+void kclock_start_slice(u_int cycles);
+int kclock_slice_expired(void);
+void kclock_arm_slice(int poll);
+
+static inline u_int kclock_count(void) {
+	u_int count;
+	asm volatile("mfc0 %0, $9" : "=r"(count));
+	return count;
+}
+
+#endif /* __ASSEMBLER__ */
 #endif
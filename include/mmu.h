@@ -6,6 +6,7 @@
  */
 
 #define NASID 256
+#define NTLB 16 // TLB entries, each mapping a pair of pages
 #define PAGE_SIZE 4096
 #define PTMAP PAGE_SIZE
 #define PDMAP (4 * 1024 * 1024) // bytes mapped by a page directory entry
@@ -16,6 +17,12 @@
 #define PTE_ADDR(pte) (((u_long)(pte)) & ~0xFFF)
 #define PTE_FLAGS(pte) (((u_long)(pte)) & 0xFFF)
 
+// Large pages are 2^LARGE_PAGE_ORDER pages, mapped by a single TLB entry (see 'PTE_LARGE').
+#define LARGE_PAGE_ORDER 4
+#define LARGE_PAGE_SIZE (PAGE_SIZE << LARGE_PAGE_ORDER)
+#define LARGE_NPAGES (1 << LARGE_PAGE_ORDER)
+#define PAGEMASK_LARGE 0x1e000 // CP0_PAGEMASK of a TLB entry with 64KB pages
+
 // Page number field of an address
 #define PPN(pa) (((u_long)(pa)) >> PGSHIFT)
 #define VPN(va) (((u_long)(va)) >> PGSHIFT)
@@ -65,6 +72,19 @@
 // Shared memmory. Reserved for software, used by fork.
 #define PTE_LIBRARY 0x0002
 
+// Donated page. Only in the 'perm' of a page sent by IPC: the page is moved to the receiver, and
+// unmapped from the sender (see 'ipc_deliver').
+#define PTE_DONATE 0x0004
+
+// Large page. Set on all the 'LARGE_NPAGES' entries mapping a physically contiguous block of
+// 'LARGE_PAGE_SIZE' bytes, aligned on its size, at an aligned address with the same flags: the
+// TLB maps it with one entry (see '_do_tlb_refill'). Changing one of these entries first clears
+// the bit on all of them.
+#define PTE_LARGE 0x0008
+
+// Private page. Not inherited by the children of 'fork' (see 'sys_fork'), which get none there.
+#define PTE_PRIVATE 0x0010
+
 // Memory segments (32-bit kernel mode addresses)
 #define KUSEG 0x00000000U
 #define KSEG0 0x80000000U
@@ -183,6 +203,9 @@ typedef u_long Pte;
 	})
 
 extern void tlb_out(u_int entryhi);
+extern void tlb_flush_asid(u_int asid);
+extern void tlb_flush_all(void);
 void tlb_invalidate(u_int asid, u_long va);
+void tlb_invalidate_range(u_int asid, u_long va, u_int npages);
 #endif //!__ASSEMBLER__
 #endif // !_MMU_H_
@@ -7,6 +7,7 @@
 #include <types.h>
 
 extern Pde *cur_pgdir;
+extern u_int *cur_tlb_refills;
 
 LIST_HEAD(Page_list, Page);
 typedef LIST_ENTRY(Page) Page_LIST_entry_t;
@@ -24,10 +25,30 @@ struct Page {
 	// do not have valid reference count fields.
 
 	u_short pp_ref;
+
+	// 'pp_free' is 'PAGE_FREE' if this page is the first of a free block of 2^'pp_order' pages
+	// (see 'page_free_order'), or 'PAGE_ZEROED' if it is in the pool of pre-zeroed pages.
+	u_char pp_order;
+	u_char pp_free;
 };
 
+#define PAGE_FREE 1
+#define PAGE_ZEROED 2
+
+/*
+ * Free pages are kept by a binary buddy allocator: a free block of order 'n' is 2^n contiguous
+ * pages starting at a multiple of 2^n pages, and is on 'page_free_list[n]'.
+ */
+#define PAGE_MAX_ORDER 10 // the largest block is 2^10 pages (4MB)
+
+/*
+ * Up to 'PAGE_ZERO_POOL' free pages are zeroed ahead of time when the CPU is idle, so that
+ * 'page_alloc' does not have to zero them. 'page_alloc_nozero' leaves them to 'page_alloc'.
+ */
+#define PAGE_ZERO_POOL 64
+
 extern struct Page *pages;
-extern struct Page_list page_free_list;
+extern struct Page_list page_free_list[PAGE_MAX_ORDER + 1];
 
 static inline u_long page2ppn(struct Page *pp) {
 	return pp - pages;
@@ -69,14 +90,25 @@ void page_init(void);
 void *alloc(u_int n, u_int align, int clear);
 
 int page_alloc(struct Page **pp);
+int page_alloc_nozero(struct Page **pp);
+int page_zero_refill(void);
 void page_free(struct Page *pp);
+int page_alloc_order(struct Page **pp, u_int order);
+void page_free_order(struct Page *pp, u_int order);
 void page_decref(struct Page *pp);
 int page_insert(Pde *pgdir, u_int asid, struct Page *pp, u_long va, u_int perm);
+int page_insert_large(Pde *pgdir, u_int asid, struct Page *pp, u_long va, u_int perm);
 struct Page *page_lookup(Pde *pgdir, u_long va, Pte **ppte);
 void page_remove(Pde *pgdir, u_int asid, u_long va);
+int page_alloc_range(Pde *pgdir, u_int asid, u_long va, u_int npages, u_int perm);
+int page_map_range(Pde *src, u_int srcasid, u_long srcva, Pde *dst, u_int dstasid, u_long dstva,
+		   u_int npages, u_int flags);
+void page_remove_range(Pde *pgdir, u_int asid, u_long va, u_int npages);
 
 extern struct Page *pages; // 页控制块
 
+void page_steal_all(struct Page_list *fl);
+void page_free_all(struct Page_list *fl);
 void physical_memory_manage_check(void);
 void page_check(void);
 
@@ -1,6 +1,43 @@
 #ifndef __SCHED_H__
 #define __SCHED_H__
 
+#include <env.h>
+#include <kclock.h>
+
+/*
+ * Scheduling policies. The policy is chosen at build time with 'make sched=<policy>', e.g.
+ * 'make sched=mlfq'. Round-robin is the default.
+ */
+#define SCHED_RR 0     // one queue, each env runs 'env_pri' ticks per turn
+#define SCHED_MLFQ 1   // multi-level feedback queue
+#define SCHED_STRIDE 2 // stride scheduling, CPU share proportional to 'env_pri'
+
+#ifndef MOS_SCHED_POLICY
+#define MOS_SCHED_POLICY SCHED_RR
+#endif
+
+// Every SCHED_BOOST_TICKS timer ticks, all envs are moved back to the highest MLFQ level.
+#define SCHED_BOOST_TICKS 200
+
+// Under SCHED_MLFQ and SCHED_STRIDE, the time slice of an env is 'SCHED_QUANTUM_MIN << order' cycles,
+// where 'order' adapts between 0 and 'SCHED_QUANTUM_MAX_ORDER' (a quarter of a tick to 8 ticks).
+#define SCHED_QUANTUM_MIN (TIMER_INTERVAL / 4)
+#define SCHED_QUANTUM_MAX_ORDER 5
+#define SCHED_QUANTUM_INIT_ORDER 2
+
+// Largest 'env_pri' (scheduling weight) that can be set with 'sys_set_sched_param'.
+#define SCHED_MAX_WEIGHT 100
+
+void sched_insert(struct Env *e, int head);
+void sched_remove(struct Env *e);
+void sched_block(struct Env_wait_list *wl);
+void sched_wakeup(struct Env *e, u_int ret);
+void sched_wait_cancel(struct Env *e);
+void sched_wait_move(struct Env *e, struct Env_wait_list *wl);
 void schedule(int yield) __attribute__((noreturn));
+void sched_switch_to(struct Env *e) __attribute__((noreturn));
+
+// Wakeup sources polled by 'schedule'. Each returns non-zero if some env is still waiting on it.
+int cons_poll(void);
 
 #endif /* __SCHED_H__ */
@@ -0,0 +1,49 @@
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include <queue.h>
+#include <types.h>
+
+/*
+ * Kernel objects are allocated from caches of objects of one size ('kmem_cache_alloc'), or by
+ * size from the caches behind 'kmalloc'. A cache carves its objects out of slabs, single pages
+ * from 'page_alloc_nozero' starting with a 'struct Slab', and chains the free objects of a slab
+ * through a link word. Allocating and freeing an object are O(1), and a cache grows by a slab
+ * whenever it is out of free objects, for as long as there is free memory.
+ *
+ * A cache may have a constructor, run on each object once when its slab is created rather than
+ * on every allocation: objects are to be freed in their constructed state, and are handed out
+ * again as they were freed. The link word is then kept after the object, so that freeing it does
+ * not clobber its contents. The objects of a cache without a constructor are not initialized.
+ */
+LIST_HEAD(Slab_list, Slab);
+
+struct Slab {
+	LIST_ENTRY(Slab) s_link;    // on 'kc_partial' or 'kc_full' of its cache
+	struct Kmem_cache *s_cache; // the cache the slab belongs to
+	void *s_free;		    // first free object, or NULL
+	u_int s_inuse;		    // number of objects allocated
+};
+
+struct Kmem_cache {
+	const char *kc_name;
+	u_int kc_size;		     // size of an object
+	void (*kc_ctor)(void *obj);  // constructor, or NULL
+	u_int kc_link;		     // offset of the link word in an object
+	u_int kc_stride;	     // distance between objects in a slab, or 0 until the first slab
+	struct Slab_list kc_partial; // slabs with free objects
+	struct Slab_list kc_full;    // slabs without free objects
+	u_int kc_nempty;	     // slabs on 'kc_partial' without allocated objects
+};
+
+// Initializer of a 'struct Kmem_cache' named 'name', of objects of 'size' bytes.
+#define KMEM_CACHE(name, size, ctor) {.kc_name = (name), .kc_size = (size), .kc_ctor = (ctor)}
+
+#define KMALLOC_MAX 2048 // largest size 'kmalloc' allocates
+
+void *kmem_cache_alloc(struct Kmem_cache *c);
+void kmem_cache_free(struct Kmem_cache *c, void *obj);
+void *kmalloc(u_int size);
+void kfree(void *obj);
+
+#endif /* _SLAB_H_ */
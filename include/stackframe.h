@@ -108,3 +108,43 @@
 .set at
 .set reorder
 .endm
+
+/*
+ * Partial frame of the syscalls taking the fast path ('handle_sys_fast'), laid out as a full
+ * 'struct Trapframe' but holding only $sp, $ra, the syscall arguments, CP0_STATUS and CP0_EPC.
+ * The other registers are either callee-saved in the C code ($s0-$s7, $fp; $gp is not used with
+ * '-G 0') or caller-saved around 'msyscall', whose callers cannot expect them to survive.
+ */
+.macro SAVE_SYSCALL
+.set noat
+.set noreorder
+	move    k0, sp
+	li      sp, KSTACKTOP
+	subu    sp, sp, TF_SIZE
+	sw      k0, TF_REG29(sp)
+	mfc0    k0, CP0_STATUS
+	sw      k0, TF_STATUS(sp)
+	mfc0    k0, CP0_EPC
+	sw      k0, TF_EPC(sp)
+	sw      $4, TF_REG4(sp)
+	sw      $5, TF_REG5(sp)
+	sw      $6, TF_REG6(sp)
+	sw      $7, TF_REG7(sp)
+	sw      $31, TF_REG31(sp)
+.set at
+.set reorder
+.endm
+
+.macro RESTORE_SYSCALL
+.set noreorder
+.set noat
+	lw      k0, TF_STATUS(sp)
+	mtc0    k0, CP0_STATUS
+	lw      k1, TF_EPC(sp)
+	mtc0    k1, CP0_EPC
+	lw      $31, TF_REG31(sp)
+	lw      $2, TF_REG2(sp)
+	lw      sp, TF_REG29(sp)
+.set at
+.set reorder
+.endm
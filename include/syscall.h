@@ -3,36 +3,84 @@
 
 #ifndef __ASSEMBLER__
 
+/*
+ * The syscalls, as X(name, nargs) for each: 'SYS_name' is handled by 'sys_name' in the kernel,
+ * which takes 'nargs' arguments. The syscall numbers, 'syscall_table' and 'syscall_nargs' are all
+ * generated from this list, so that they cannot disagree.
+ */
+#define SYSCALL_LIST(X)                                                                            \
+	X(putchar, 1)                                                                              \
+	X(print_cons, 2)                                                                           \
+	X(getenvid, 0)                                                                             \
+	X(yield, 0)                                                                                \
+	X(env_destroy, 1)                                                                          \
+	X(set_tlb_mod_entry, 2)                                                                    \
+	X(mem_alloc, 3)                                                                            \
+	X(mem_map, 5)                                                                              \
+	X(mem_unmap, 2)                                                                            \
+	X(exofork, 0)                                                                              \
+	X(set_env_status, 2)                                                                       \
+	X(set_trapframe, 2)                                                                        \
+	X(panic, 1)                                                                                \
+	X(ipc_try_send, 4)                                                                         \
+	X(ipc_recv, 1)                                                                             \
+	X(cgetc, 0)                                                                                \
+	X(write_dev, 3)                                                                            \
+	X(read_dev, 3)                                                                             \
+	X(get_cur_path, 1)                                                                         \
+	X(set_cur_path, 1)                                                                         \
+	X(alloc_shell_id, 0)                                                                       \
+	X(declare_var, 4)                                                                          \
+	X(unset_var, 2)                                                                            \
+	X(get_var, 3)                                                                              \
+	X(get_all_var, 2)                                                                          \
+	X(get_parent_id, 1)                                                                        \
+	X(sleep, 1)                                                                                \
+	X(ipc_recv_timed, 2)                                                                       \
+	X(clock, 0)                                                                                \
+	X(set_sched_param, 2)                                                                      \
+	X(yield_to, 1)                                                                             \
+	X(ipc_send, 5)                                                                             \
+	X(ipc_call, 6)                                                                             \
+	X(ipc_reply_wait, 6)                                                                       \
+	X(notify, 2)                                                                               \
+	X(notify_wait, 2)                                                                          \
+	X(chan_create, 3)                                                                          \
+	X(chan_attach, 2)                                                                          \
+	X(chan_signal, 2)                                                                          \
+	X(chan_detach, 1)                                                                          \
+	X(ipc_sendv, 5)                                                                            \
+	X(ipc_recvv, 2)                                                                            \
+	X(ipc_callv, 5)                                                                            \
+	X(ipc_replyv_wait, 5)                                                                      \
+	X(submit, 2)                                                                               \
+	X(mem_alloc_range, 4)                                                                      \
+	X(mem_map_range, 5)                                                                        \
+	X(mem_unmap_range, 3)                                                                      \
+	X(fork, 0)
+
+#define SYSCALL_ENUM(name, nargs) SYS_##name,
+
 enum {
-	SYS_putchar,
-	SYS_print_cons,
-	SYS_getenvid,
-	SYS_yield,
-	SYS_env_destroy,
-	SYS_set_tlb_mod_entry,
-	SYS_mem_alloc,
-	SYS_mem_map,
-	SYS_mem_unmap,
-	SYS_exofork,
-	SYS_set_env_status,
-	SYS_set_trapframe,
-	SYS_panic,
-	SYS_ipc_try_send,
-	SYS_ipc_recv,
-	SYS_cgetc,
-	SYS_write_dev,
-	SYS_read_dev,
-	SYS_get_cur_path,
-	SYS_set_cur_path,
-	SYS_alloc_shell_id,
-	SYS_declare_var,
-	SYS_unset_var,
-	SYS_get_var,
-	SYS_get_all_var,
-	SYS_get_parent_id,
-	MAX_SYSNO,
+	SYSCALL_LIST(SYSCALL_ENUM) MAX_SYSNO,
+};
+
+// Flags of 'sys_mem_map_range'.
+#define MAP_COW 0x1	// map writable pages copy-on-write in both envs, as 'fork' does
+#define MAP_LIBRARY 0x2 // map only the pages shared with 'PTE_LIBRARY'
+
+/*
+ * An entry of a batch of syscalls run with a single 'sys_submit': the syscall 'sqe_sysno' is called
+ * with 'sqe_args', and its return value is posted to 'sqe_ret'.
+ */
+struct Sqe {
+	unsigned int sqe_sysno;
+	unsigned int sqe_args[6];
+	int sqe_ret;
 };
 
+#define SQE_MAX 128 // entries in a batch (a page of them)
+
 #endif
 
 #endif
@@ -0,0 +1,209 @@
+#include <chan.h>
+#include <env.h>
+#include <error.h>
+#include <pmap.h>
+
+/*
+ * Each channel holds a reference to its pages, so that they outlive the mappings of either
+ * endpoint. A channel slot is freed (and its pages released) once both endpoints have detached,
+ * either with 'sys_chan_detach' or by being destroyed.
+ */
+struct Channel {
+	u_int ch_npages;		       // number of pages, or 0 if the slot is free
+	u_int ch_envs[2];		       // envids of the creator and the peer, 0 once detached
+	u_int ch_attached;		       // whether the peer has mapped the pages
+	struct Page *ch_pages[CHAN_MAX_PAGES]; // the shared pages
+};
+
+static struct Channel chans[NCHAN];
+
+/* Overview:
+ *   Drop the references of channel 'ch' to its pages, freeing its slot.
+ */
+static void channel_free(struct Channel *ch) {
+	u_int i;
+
+	for (i = 0; i < ch->ch_npages; i++) {
+		page_decref(ch->ch_pages[i]);
+	}
+	ch->ch_npages = 0;
+}
+
+/* Overview:
+ *   Map the pages of channel 'ch' into 'e' from 'va' on, writable and shared across 'fork'.
+ *
+ * Post-Condition:
+ *   Return 0 on success. On error, no page of 'ch' is left mapped and the error is returned.
+ */
+static int channel_map(struct Channel *ch, struct Env *e, u_int va) {
+	u_int i;
+	int r;
+
+	for (i = 0; i < ch->ch_npages; i++) {
+		r = page_insert(e->env_pgdir, e->env_asid, ch->ch_pages[i], va + i * PAGE_SIZE,
+				PTE_D | PTE_LIBRARY);
+		if (r != 0) {
+			while (i-- > 0) {
+				page_remove(e->env_pgdir, e->env_asid, va + i * PAGE_SIZE);
+			}
+			return r;
+		}
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Look up the channel 'chanid' of which 'e' is an endpoint.
+ *
+ * Post-Condition:
+ *   Return the channel and set '*end' to the index of 'e' in 'ch_envs', or return NULL if there
+ *   is no such channel.
+ */
+static struct Channel *channel_lookup(struct Env *e, int chanid, int *end) {
+	struct Channel *ch;
+
+	if (chanid < 0 || chanid >= NCHAN || chans[chanid].ch_npages == 0) {
+		return NULL;
+	}
+	ch = &chans[chanid];
+	if (ch->ch_envs[0] == e->env_id) {
+		*end = 0;
+	} else if (ch->ch_envs[1] == e->env_id) {
+		*end = 1;
+	} else {
+		return NULL;
+	}
+	return ch;
+}
+
+/* Overview:
+ *   Create a channel of 'npages' zeroed pages between 'e' and 'peer', mapping them into 'e' from
+ *   'va' on.
+ *
+ * Pre-Condition:
+ *   'npages' is between 1 and 'CHAN_MAX_PAGES', and the range at 'va' is valid user memory.
+ *
+ * Post-Condition:
+ *   Return the id of the new channel on success.
+ *   Return -E_NO_MEM: no free channel slot or not enough memory.
+ */
+int channel_create(struct Env *e, struct Env *peer, u_int npages, u_int va) {
+	struct Channel *ch;
+	struct Page *p;
+	int chanid, r;
+
+	for (chanid = 0; chanid < NCHAN && chans[chanid].ch_npages != 0; chanid++) {
+	}
+	if (chanid == NCHAN) {
+		return -E_NO_MEM;
+	}
+	ch = &chans[chanid];
+	while (ch->ch_npages < npages) {
+		if ((r = page_alloc(&p)) != 0) {
+			channel_free(ch);
+			return r;
+		}
+		p->pp_ref++;
+		ch->ch_pages[ch->ch_npages++] = p;
+	}
+	if ((r = channel_map(ch, e, va)) != 0) {
+		channel_free(ch);
+		return r;
+	}
+	ch->ch_envs[0] = e->env_id;
+	ch->ch_envs[1] = peer->env_id;
+	ch->ch_attached = 0;
+	return chanid;
+}
+
+/* Overview:
+ *   Look up the size of channel 'chanid', of which 'e' is an endpoint.
+ *
+ * Post-Condition:
+ *   Return the number of pages of the channel on success.
+ *   Return -E_INVAL: 'e' is not an endpoint of the channel.
+ */
+int channel_npages(struct Env *e, int chanid) {
+	struct Channel *ch;
+	int end;
+
+	if ((ch = channel_lookup(e, chanid, &end)) == NULL) {
+		return -E_INVAL;
+	}
+	return ch->ch_npages;
+}
+
+/* Overview:
+ *   Map the pages of channel 'chanid' into 'e', its peer, from 'va' on.
+ *
+ * Post-Condition:
+ *   Return the number of pages of the channel on success.
+ *   Return -E_INVAL: 'e' is not the peer of the channel, or has already attached.
+ */
+int channel_attach(struct Env *e, int chanid, u_int va) {
+	struct Channel *ch;
+	int end;
+
+	if ((ch = channel_lookup(e, chanid, &end)) == NULL || end != 1 || ch->ch_attached) {
+		return -E_INVAL;
+	}
+	try(channel_map(ch, e, va));
+	ch->ch_attached = 1;
+	return ch->ch_npages;
+}
+
+/* Overview:
+ *   Store in '*peer' the envid of the other endpoint of channel 'chanid', of which 'e' is one.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_INVAL: 'e' is not an endpoint of the channel.
+ *   Return -E_BAD_ENV: the other endpoint has detached.
+ */
+int channel_peer(struct Env *e, int chanid, u_int *peer) {
+	struct Channel *ch;
+	int end;
+
+	if ((ch = channel_lookup(e, chanid, &end)) == NULL) {
+		return -E_INVAL;
+	}
+	if ((*peer = ch->ch_envs[1 - end]) == 0) {
+		return -E_BAD_ENV;
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Detach 'e' from channel 'chanid', freeing the channel if the other endpoint is gone too.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_INVAL: 'e' is not an endpoint of the channel.
+ *
+ * Hint:
+ *   The pages stay mapped in 'e': unmapping them is up to the caller.
+ */
+int channel_detach(struct Env *e, int chanid) {
+	struct Channel *ch;
+	int end;
+
+	if ((ch = channel_lookup(e, chanid, &end)) == NULL) {
+		return -E_INVAL;
+	}
+	ch->ch_envs[end] = 0;
+	if (ch->ch_envs[1 - end] == 0) {
+		channel_free(ch);
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Detach 'e', which is being freed, from all its channels.
+ */
+void channel_release(struct Env *e) {
+	int chanid;
+
+	for (chanid = 0; chanid < NCHAN; chanid++) {
+		channel_detach(e, chanid);
+	}
+}
@@ -1,12 +1,15 @@
 #include <asm/cp0regdef.h>
+#include <chan.h>
 #include <elf.h>
 #include <env.h>
+#include <kclock.h>
 #include <mmu.h>
 #include <pmap.h>
 #include <printk.h>
 #include <sched.h>
+#include <slab.h>
 
-struct Env envs[NENV] __attribute__((aligned(PAGE_SIZE))); // All environments
+struct Env envs[NENV] __attribute__((aligned(LARGE_PAGE_SIZE))); // All environments
 
 struct Env *curenv = NULL;	      // the current env
 static struct Env_list env_free_list; // Free list
@@ -15,50 +18,67 @@ static struct Env_list env_free_list; // Free list
 char cur_path[128] = "/";
 
 // Invariant: 'env' in 'env_sched_list' iff. 'env->env_status' is 'RUNNABLE'.
-struct Env_sched_list env_sched_list; // Runnable list
+struct Env_sched_list env_sched_list[NSCHED_LEVEL]; // Runnable lists, one per MLFQ level
 
 static Pde *base_pgdir;
 
-static uint32_t asid_bitmap[NASID / 32] = {0};
+/*
+ * ASIDs are handed out in generations, so that there is no limit on the number of envs: the bits
+ * of 'env_asid' above the hardware ASID hold the generation it was allocated in. When all the
+ * ASIDs of a generation are taken, the next generation starts with a flushed TLB, and the envs
+ * holding ASIDs of an older one get new ones when they next run ('env_run').
+ */
+#define ASID_MASK (NASID - 1)
+
+static u_int asid_generation = NASID;		// current generation, in the bits above 'ASID_MASK'
+static uint32_t asid_bitmap[NASID / 32] = {0}; // ASIDs taken in the current generation
 
 /* Overview:
- *  Allocate an unused ASID.
+ *  Allocate an unused ASID of the current generation to 'e', starting a new generation if there
+ *  is none.
  *
  * Post-Condition:
- *   return 0 and set '*asid' to the allocated ASID on success.
- *   return -E_NO_FREE_ENV if no ASID is available.
+ *  'e->env_asid' is the ASID allocated, tagged with its generation.
  */
-static int asid_alloc(u_int *asid) {
-	for (u_int i = 0; i < NASID; ++i) {
-		int index = i >> 5;
-		int inner = i & 31;
-		if ((asid_bitmap[index] & (1 << inner)) == 0) {
-			asid_bitmap[index] |= 1 << inner;
-			*asid = i;
-			return 0;
+static void asid_alloc(struct Env *e) {
+	u_int i, bit;
+
+	for (i = 0; i < NASID / 32 && asid_bitmap[i] == ~0u; i++) {
+	}
+	if (i == NASID / 32) {
+		asid_generation += NASID;
+		if (asid_generation == 0) {
+			asid_generation = NASID;
 		}
+		memset(asid_bitmap, 0, sizeof(asid_bitmap));
+		tlb_flush_all();
+		i = 0;
 	}
-	return -E_NO_FREE_ENV;
+	bit = __builtin_ctz(~asid_bitmap[i]);
+	asid_bitmap[i] |= 1 << bit;
+	e->env_asid = asid_generation | (i * 32 + bit);
 }
 
 /* Overview:
- *  Free an ASID.
- *
- * Pre-Condition:
- *  The ASID is allocated by 'asid_alloc'.
+ *  Free the ASID 'asid' of an env being freed.
  *
  * Post-Condition:
- *  The ASID is freed and may be allocated again later.
+ *  If it is of the current generation, the TLB has no entries of it left, and it may be allocated
+ *  again. Otherwise nothing is done: the TLB has been flushed since it was allocated.
  */
-static void asid_free(u_int i) {
-	int index = i >> 5;
-	int inner = i & 31;
-	asid_bitmap[index] &= ~(1 << inner);
+static void asid_free(u_int asid) {
+	if ((asid & ~ASID_MASK) != asid_generation) {
+		return;
+	}
+	tlb_flush_asid(asid & ASID_MASK);
+	asid &= ASID_MASK;
+	asid_bitmap[asid >> 5] &= ~(1 << (asid & 31));
 }
 
 /* Overview:
  *   Map [va, va+size) of virtual address space to physical [pa, pa+size) in the 'pgdir'. Use
- *   permission bits 'perm | PTE_V' for the entries.
+ *   permission bits 'perm | PTE_V' for the entries. The parts where both addresses are aligned on
+ *   'LARGE_PAGE_SIZE' are mapped with large pages.
  *
  * Pre-Condition:
  *   'pa', 'va' and 'size' are aligned to 'PAGE_SIZE'.
@@ -71,6 +91,12 @@ static void map_segment(Pde *pgdir, u_int asid, u_long pa, u_long va, u_int size
 
 	/* Step 1: Map virtual address space to physical address space. */
 	for (int i = 0; i < size; i += PAGE_SIZE) {
+		if ((pa + i) % LARGE_PAGE_SIZE == 0 && (va + i) % LARGE_PAGE_SIZE == 0 &&
+		    size - i >= LARGE_PAGE_SIZE) {
+			panic_on(page_insert_large(pgdir, asid, pa2page(pa + i), va + i, perm));
+			i += LARGE_PAGE_SIZE - PAGE_SIZE;
+			continue;
+		}
 		/*
 		 * Hint:
 		 *  Map the virtual page 'va + i' to the physical page 'pa + i' using 'page_insert'.
@@ -154,7 +180,9 @@ void env_init(void) {
 	 * 'TAILQ_INIT'. */
 	/* Exercise 3.1: Your code here. (1/2) */
 	LIST_INIT(&env_free_list);
-	TAILQ_INIT(&env_sched_list);
+	for (i = 0; i < NSCHED_LEVEL; i++) {
+		TAILQ_INIT(&env_sched_list[i]);
+	}
 	/* Step 2: Traverse the elements of 'envs' array, set their status to 'ENV_FREE' and insert
 	 * them into the 'env_free_list'. Make sure, after the insertion, the order of envs in the
 	 * list should be the same as they are in the 'envs' array. */
@@ -171,6 +199,9 @@ void env_init(void) {
 	 *
 	 * Here we first map them into the *template* page directory 'base_pgdir'.
 	 * Later in 'env_setup_vm', we will copy them into each 'env_pgdir'.
+	 *
+	 * Both are aligned on 'LARGE_PAGE_SIZE' so that they are mapped with large pages, taking few
+	 * TLB entries: 'pages' is even allocated as whole large pages.
 	 */
 	struct Page *p;
 	panic_on(page_alloc(&p));
@@ -178,7 +209,7 @@ void env_init(void) {
 
 	base_pgdir = (Pde *)page2kva(p);
 	map_segment(base_pgdir, 0, PADDR(pages), UPAGES,
-		    ROUND(npage * sizeof(struct Page), PAGE_SIZE), PTE_G);
+		    ROUND(npage * sizeof(struct Page), LARGE_PAGE_SIZE), PTE_G);
 	map_segment(base_pgdir, 0, PADDR(envs), UENVS, ROUND(NENV * sizeof(struct Env), PAGE_SIZE),
 		    PTE_G);
 }
@@ -223,11 +254,11 @@ static int env_setup_vm(struct Env *e) {
  *
  * Post-Condition:
  *   return 0 on success, and basic fields of the new Env are set up.
- *   return < 0 on error, if no free env, no free asid, or 'env_setup_vm' failed.
+ *   return < 0 on error, if no free env or 'env_setup_vm' failed.
  *
  * Hints:
  *   You may need to use these functions or macros:
- *     'LIST_FIRST', 'LIST_REMOVE', 'mkenvid', 'asid_alloc', 'env_setup_vm'
+ *     'LIST_FIRST', 'LIST_REMOVE', 'mkenvid', 'env_setup_vm'
  *   Following fields of Env should be set up:
  *     'env_id', 'env_asid', 'env_parent_id', 'env_tf.regs[29]', 'env_tf.cp0_status',
  *     'env_user_tlb_mod_entry', 'env_runs'
@@ -252,16 +283,31 @@ int env_alloc(struct Env **new, u_int parent_id) {
 	 *   'env_parent_id' (lab3)
 	 *
 	 * Hint:
-	 *   Use 'asid_alloc' to allocate a free asid.
+	 *   'env_asid' is left of no generation: an ASID is allocated when the env first runs.
 	 *   Use 'mkenvid' to allocate a free envid.
 	 */
 	e->env_user_tlb_mod_entry = 0; // for lab4
 	e->env_runs = 0;	       // for lab6
+	e->env_sched_level = 0;
+	e->env_sched_epoch = 0;
+	e->env_stride_pass = 0;
+	e->env_quantum_order = SCHED_QUANTUM_INIT_ORDER;
+	e->env_wait_list = NULL;
+	e->env_timer_armed = 0;
+	e->env_ipc_handoff = 0;
+	TAILQ_INIT(&e->env_ipc_senders);
+	TAILQ_INIT(&e->env_ipc_callers);
+	e->env_ipc_recv_from = 0;
+	e->env_ipc_calling = 0;
+	e->env_ipc_msg.len = 0;
+	e->env_ipc_npages = 0;
+	e->env_notify_bits = e->env_notify_mask = 0;
+	e->env_utime = e->env_ktime = 0;
+	e->env_syscalls = e->env_nvcsw = e->env_nivcsw = e->env_nintr = 0;
+	e->env_tlb_refills = e->env_cow_faults = 0;
 	/* Exercise 3.4: Your code here. (3/4) */
 	e->env_id = mkenvid(e);
-	if ((r = asid_alloc(&e->env_asid)) != 0) {
-		return r;
-	}
+	e->env_asid = 0;
 	e->env_parent_id = parent_id;
 	/* Step 4: Initialize the sp and 'cp0_status' in 'e->env_tf'.
 	 *   Set the EXL bit to ensure that the processor remains in kernel mode during context
@@ -300,11 +346,14 @@ static int load_icode_mapper(void *data, u_long va, size_t offset, u_int perm, c
 			     size_t len) {
 	struct Env *env = (struct Env *)data;
 	struct Page *p;
+	u_char *kva;
 	int r;
 
 	/* Step 1: Allocate a page with 'page_alloc'. */
 	/* Exercise 3.5: Your code here. (1/2) */
-	if ((r = page_alloc(&p)) != 0) {
+	// A page filled from 'src' is allocated with 'page_alloc_nozero': only the bytes around the
+	// copied ones have to be zeroed.
+	if ((r = src != NULL ? page_alloc_nozero(&p) : page_alloc(&p)) != 0) {
 		return r;
 	}
 	/* Step 2: If 'src' is not NULL, copy the 'len' bytes started at 'src' into 'offset' at this
@@ -312,7 +361,10 @@ static int load_icode_mapper(void *data, u_long va, size_t offset, u_int perm, c
 	// Hint: You may want to use 'memcpy'.
 	if (src != NULL) {
 		/* Exercise 3.5: Your code here. (2/2) */
-		memcpy((void *)(page2kva(p) + offset), src, len);
+		kva = (u_char *)page2kva(p);
+		memset(kva, 0, offset);
+		memcpy(kva + offset, src, len);
+		memset(kva + offset + len, 0, PAGE_SIZE - offset - len);
 	}
 
 	/* Step 3: Insert 'p' into 'env->env_pgdir' at 'va' with 'perm'. */
@@ -368,10 +420,10 @@ struct Env *env_create(const void *binary, size_t size, int priority) {
 	e->env_pri = priority;
 	e->env_status = ENV_RUNNABLE;
 	/* Step 3: Use 'load_icode' to load the image from 'binary', and insert 'e' into
-	 * 'env_sched_list' using 'TAILQ_INSERT_HEAD'. */
+	 * 'env_sched_list' using 'sched_insert'. */
 	/* Exercise 3.7: Your code here. (3/3) */
 	load_icode(e, binary, size);
-	TAILQ_INSERT_HEAD(&env_sched_list, e, env_sched_link);
+	sched_insert(e, 1);
 	return e;
 }
 
@@ -381,6 +433,7 @@ struct Env *env_create(const void *binary, size_t size, int priority) {
 void env_free(struct Env *e) {
 	Pte *pt;
 	u_int pdeno, pteno, pa;
+	struct Env *s;
 
 	/* Hint: Note the environment's demise.*/
 	printk("[%08x] free env %08x\n", curenv ? curenv->env_id : 0, e->env_id);
@@ -409,14 +462,29 @@ void env_free(struct Env *e) {
 	}
 	/* Hint: free the page directory. */
 	page_decref(pa2page(PADDR(e->env_pgdir)));
-	/* Hint: free the ASID */
-	asid_free(e->env_asid);
 	/* Hint: invalidate page directory in TLB */
 	tlb_invalidate(e->env_asid, UVPT + (PDX(UVPT) << PGSHIFT));
+	/* Hint: free the ASID */
+	asid_free(e->env_asid);
 	/* Hint: return the environment to the free list. */
+	if (e->env_status == ENV_RUNNABLE) {
+		sched_remove(e);
+	}
+	sched_wait_cancel(e);
+	// Fail the sends still blocked on us, and the calls still waiting for our reply.
+	while ((s = TAILQ_FIRST(&e->env_ipc_senders)) != NULL) {
+		sched_wakeup(s, -E_BAD_ENV);
+	}
+	while ((s = TAILQ_FIRST(&e->env_ipc_callers)) != NULL) {
+		s->env_ipc_recving = 0;
+		sched_wakeup(s, -E_BAD_ENV);
+	}
+#if !defined(LAB) || LAB >= 4
+	channel_release(e);
+#endif
+	env_free_vars(e);
 	e->env_status = ENV_FREE;
 	LIST_INSERT_HEAD((&env_free_list), (e), env_link);
-	TAILQ_REMOVE(&env_sched_list, (e), env_sched_link);
 }
 
 /* Overview:
@@ -467,6 +535,7 @@ void env_run(struct Env *e) {
 	if (curenv) {
 		curenv->env_tf = *((struct Trapframe *)KSTACKTOP - 1);
 	}
+	kclock_leave_kernel();
 
 	/* Step 2: Change 'curenv' to 'e'. */
 	curenv = e;
@@ -475,6 +544,10 @@ void env_run(struct Env *e) {
 	/* Step 3: Change 'cur_pgdir' to 'curenv->env_pgdir', switching to its address space. */
 	/* Exercise 3.8: Your code here. (1/2) */
 	cur_pgdir = curenv->env_pgdir;
+	cur_tlb_refills = &curenv->env_tlb_refills;
+	if ((curenv->env_asid & ~ASID_MASK) != asid_generation) {
+		asid_alloc(curenv);
+	}
 	/* Step 4: Use 'env_pop_tf' to restore the curenv's saved context (registers) and return/go
 	 * to user mode.
 	 *
@@ -484,7 +557,7 @@ void env_run(struct Env *e) {
 	 *    returning to the kernel caller, making 'env_run' a 'noreturn' function as well.
 	 */
 	/* Exercise 3.8: Your code here. (2/2) */
-	env_pop_tf(&curenv->env_tf, curenv->env_asid);	
+	env_pop_tf(&curenv->env_tf, curenv->env_asid & ASID_MASK);	
 }
 
 void env_check() {
@@ -541,9 +614,10 @@ void env_check() {
 	printk("pe2`s sp register %x\n", pe2->env_tf.regs[29]);
 
 	/* free all env allocated in this function */
-	TAILQ_INSERT_TAIL(&env_sched_list, pe0, env_sched_link);
-	TAILQ_INSERT_TAIL(&env_sched_list, pe1, env_sched_link);
-	TAILQ_INSERT_TAIL(&env_sched_list, pe2, env_sched_link);
+	pe0->env_status = pe1->env_status = pe2->env_status = ENV_RUNNABLE;
+	sched_insert(pe0, 0);
+	sched_insert(pe1, 0);
+	sched_insert(pe2, 0);
 
 	env_free(pe2);
 	env_free(pe1);
@@ -574,31 +648,24 @@ void envid2env_check() {
 }
 
 /* ---------------- 环境变量支持开始 ---------------- */
-#define MAX_VAR_COUNT 128
-static struct Var var_pool[MAX_VAR_COUNT];
-static int var_pool_used[MAX_VAR_COUNT] = {0};
+static struct Kmem_cache var_cache = KMEM_CACHE("var", sizeof(struct Var), NULL);
 
 /* 分配一个 Var 节点 */
 static struct Var *alloc_var(void) {
-    for (int i = 0; i < MAX_VAR_COUNT; i++) {
-        if (!var_pool_used[i]) {
-            var_pool_used[i] = 1;
-            var_pool[i].name[0] = '\0';
-            var_pool[i].value[0] = '\0';
-            var_pool[i].perm = 0;
-            var_pool[i].owner = 0;
-            var_pool[i].next = 0;
-            return &var_pool[i];
-        }
+    struct Var *v = kmem_cache_alloc(&var_cache);
+    if (v) {
+        v->name[0] = '\0';
+        v->value[0] = '\0';
+        v->perm = 0;
+        v->owner = 0;
+        v->next = 0;
     }
-    return 0;
+    return v;
 }
 
 /* 释放一个 Var 节点 */
 static void free_var(struct Var *v) {
-    int index = v - var_pool;
-    if (index >= 0 && index < MAX_VAR_COUNT)
-        var_pool_used[index] = 0;
+    kmem_cache_free(&var_cache, v);
 }
 
 /* envvar_declare: 在指定 env->env_vars 链表中，声明或更新变量
@@ -716,4 +783,13 @@ void env_copy_vars(struct Env *child, struct Env *parent) {
         }
         p = p->next;
     }
-}
\ No newline at end of file
+}
+
+/* 释放进程的所有环境变量（进程销毁时调用） */
+void env_free_vars(struct Env *e) {
+    struct Var *v;
+    while ((v = e->env_vars) != 0) {
+        e->env_vars = v->next;
+        free_var(v);
+    }
+}
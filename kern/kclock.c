@@ -0,0 +1,217 @@
+#include <env.h>
+#include <error.h>
+#include <kclock.h>
+#include <sched.h>
+
+/*
+ * Time is kept by the free-running CP0_COUNT register. A timer tick is due every 'TIMER_INTERVAL'
+ * cycles, and 'kclock_update' catches 'kclock_jiffies' up with the ticks elapsed since its last
+ * call, so ticks are never lost even when the timer interrupt was armed further away (e.g. when
+ * idle).
+ *
+ * Env timers live in a hashed timer wheel: a timer expiring at tick 't' is kept in slot
+ * 't % KCLOCK_WHEEL_SIZE', and each tick only looks at its own slot.
+ */
+#define KCLOCK_WHEEL_SIZE 64 // must be a power of 2
+
+LIST_HEAD(Env_timer_list, Env);
+
+u_int kclock_compare; // value written to CP0_COMPARE by 'RESET_KCLOCK'
+u_int kclock_jiffies; // timer ticks since boot
+
+static int kclock_started;
+static u_int kclock_next;      // CP0_COUNT value at which the next tick is due
+static u_int kclock_hi;	       // high word of the 64-bit cycle counter
+static u_int kclock_last;      // CP0_COUNT value seen by the last 'kclock_cycles'
+static u_int kclock_ntimers;   // number of armed timers
+static uint64_t kclock_stamp;  // cycle count at the last CPU time accounting point
+static u_int kclock_slice_end; // CP0_COUNT value at which the current time slice ends
+static struct Env_timer_list kclock_wheel[KCLOCK_WHEEL_SIZE];
+
+/* Overview:
+ *   Return the number of cycles elapsed since CP0_COUNT started, extended to 64 bits.
+ *
+ * Hint:
+ *   A wrap-around of CP0_COUNT is detected by comparing with the last value seen, so this must be
+ *   called at least once per wrap-around period. 'kclock_update' calls it on every tick.
+ */
+uint64_t kclock_cycles(void) {
+	u_int count = kclock_count();
+
+	if (count < kclock_last) {
+		kclock_hi++;
+	}
+	kclock_last = count;
+	return ((uint64_t)kclock_hi << 32) | count;
+}
+
+/* Overview:
+ *   Wake up 'e', whose timer has expired.
+ *
+ * Post-Condition:
+ *   A timed IPC receive returns -E_TIMEOUT. Any other timed wait returns 0 (for a notification
+ *   wait, no bits).
+ */
+static void kclock_expire(struct Env *e) {
+	int ret = 0;
+
+	if (e->env_ipc_recving) {
+		e->env_ipc_recving = 0;
+		ret = -E_TIMEOUT;
+	}
+	e->env_notify_mask = 0;
+	sched_wakeup(e, ret);
+}
+
+/* Overview:
+ *   Run the timers expiring at tick 'tick'.
+ */
+static void kclock_run(u_int tick) {
+	struct Env *e, *next;
+
+	for (e = LIST_FIRST(&kclock_wheel[tick & (KCLOCK_WHEEL_SIZE - 1)]); e != NULL; e = next) {
+		next = LIST_NEXT(e, env_timer_link);
+		if ((int)(e->env_timer_expire - tick) <= 0) {
+			kclock_cancel(e);
+			kclock_expire(e);
+		}
+	}
+}
+
+/* Overview:
+ *   Account for the ticks elapsed since the last call, running the timers that expire, and set
+ *   'kclock_compare' to the next tick.
+ *
+ * Hint:
+ *   This is called on every scheduling decision, in particular on each timer interrupt.
+ */
+void kclock_update(void) {
+	u_int count = (u_int)kclock_cycles();
+
+	if (!kclock_started) {
+		kclock_started = 1;
+		kclock_next = count + TIMER_INTERVAL;
+	}
+	while ((int)(count - kclock_next) >= 0) {
+		kclock_jiffies++;
+		kclock_next += TIMER_INTERVAL;
+		kclock_run(kclock_jiffies);
+	}
+	kclock_compare = kclock_next;
+}
+
+/* Overview:
+ *   Return non-zero if some env is waiting for its timer.
+ */
+int kclock_pending(void) {
+	return kclock_ntimers != 0;
+}
+
+/* Overview:
+ *   Return the CP0_COUNT value at which the next tick with a timer to run is due, or at which
+ *   the wheel has to be looked at again.
+ *
+ * Hint:
+ *   The wheel is scanned at most one round ahead, so this is never more than
+ *   'KCLOCK_WHEEL_SIZE' ticks away, far less than a wrap-around of CP0_COUNT.
+ */
+static u_int kclock_next_timer(void) {
+	u_int d = 1;
+
+	while (d < KCLOCK_WHEEL_SIZE &&
+	       LIST_EMPTY(&kclock_wheel[(kclock_jiffies + d) & (KCLOCK_WHEEL_SIZE - 1)])) {
+		d++;
+	}
+	return kclock_next + (d - 1) * TIMER_INTERVAL;
+}
+
+/* Overview:
+ *   Set 'kclock_compare' for an idle CPU: the next tick if 'poll' is set (some wakeup source has
+ *   to be polled), or else the first tick with a timer to run.
+ */
+void kclock_set_idle(int poll) {
+	kclock_compare = poll ? kclock_next : kclock_next_timer();
+}
+
+/* Overview:
+ *   Start a time slice of 'cycles' cycles from now.
+ */
+void kclock_start_slice(u_int cycles) {
+	kclock_slice_end = kclock_count() + cycles;
+}
+
+/* Overview:
+ *   Return non-zero if the current time slice is used up.
+ */
+int kclock_slice_expired(void) {
+	return (int)(kclock_count() - kclock_slice_end) >= 0;
+}
+
+/* Overview:
+ *   Set 'kclock_compare' to the end of the current time slice, or to the next tick if something
+ *   has to be woken up then (a wakeup source to poll if 'poll' is set, or a timer to run).
+ */
+void kclock_arm_slice(int poll) {
+	u_int next = kclock_slice_end;
+
+	if (poll) {
+		next = kclock_next;
+	} else if (kclock_ntimers != 0) {
+		next = kclock_next_timer();
+	}
+	kclock_compare = (int)(next - kclock_slice_end) < 0 ? next : kclock_slice_end;
+}
+
+/* Overview:
+ *   Arm the timer of 'e' to expire 'ticks' ticks from now, replacing any armed one.
+ *
+ * Pre-Condition:
+ *   'e' is blocked (or about to be), and will be woken up by 'sched_wakeup' when the timer
+ *   expires.
+ */
+void kclock_arm(struct Env *e, u_int ticks) {
+	kclock_cancel(e);
+	e->env_timer_expire = kclock_jiffies + ticks;
+	LIST_INSERT_HEAD(&kclock_wheel[e->env_timer_expire & (KCLOCK_WHEEL_SIZE - 1)], e,
+			 env_timer_link);
+	e->env_timer_armed = 1;
+	kclock_ntimers++;
+}
+
+/* Overview:
+ *   Disarm the timer of 'e', if armed.
+ */
+void kclock_cancel(struct Env *e) {
+	if (e->env_timer_armed) {
+		LIST_REMOVE(e, env_timer_link);
+		e->env_timer_armed = 0;
+		kclock_ntimers--;
+	}
+}
+
+/* Overview:
+ *   Charge the cycles since the last accounting point to 'curenv' as user time. Called by
+ *   'exc_gen_entry' on each exception taken from user mode.
+ */
+void kclock_enter_kernel(void) {
+	uint64_t now = kclock_cycles();
+
+	curenv->env_utime += now - kclock_stamp;
+	kclock_stamp = now;
+}
+
+/* Overview:
+ *   Charge the cycles since the last accounting point to 'curenv' (if any) as kernel time. Called
+ *   by 'ret_from_exception' before returning to user mode, and before switching 'curenv'.
+ *
+ * Hint:
+ *   While the CPU is idle 'curenv' is NULL, so idle time is not charged to any env.
+ */
+void kclock_leave_kernel(void) {
+	uint64_t now = kclock_cycles();
+
+	if (curenv != NULL) {
+		curenv->env_ktime += now - kclock_stamp;
+	}
+	kclock_stamp = now;
+}
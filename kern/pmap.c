@@ -4,6 +4,7 @@
 #include <mmu.h>
 #include <pmap.h>
 #include <printk.h>
+#include <syscall.h>
 
 /* These variables are set by mips_detect_memory(ram_low_size); */
 static u_long memsize; /* Maximum physical address */
@@ -14,7 +15,10 @@ Pde *cur_pgdir;
 struct Page *pages;
 static u_long freemem;
 
-struct Page_list page_free_list; /* Free list of physical pages */
+struct Page_list page_free_list[PAGE_MAX_ORDER + 1]; /* Free blocks of physical pages, by order */
+
+static struct Page_list page_zero_pool; /* Free pages already filled with zero */
+static u_int page_zero_count;		/* Number of pages in 'page_zero_pool' */
 
 /* Overview:
  *   Use '_memsize' from bootloader to initialize 'memsize' and
@@ -78,22 +82,29 @@ void mips_vm_init() {
 	 * for physical memory management. Then, map virtual address `UPAGES` to
 	 * physical address `pages` allocated before. For consideration of alignment,
 	 * you should round up the memory size before map. */
-	pages = (struct Page *)alloc(npage * sizeof(struct Page), PAGE_SIZE, 1);
+	// Whole large pages, for 'UPAGES' to be mapped with large pages only (see 'env_init').
+	pages = (struct Page *)alloc(ROUND(npage * sizeof(struct Page), LARGE_PAGE_SIZE),
+				     LARGE_PAGE_SIZE, 1);
 	printk("to memory %x for struct Pages.\n", freemem);
 	printk("pmap.c:\t mips vm init success\n");
 }
 
 /* Overview:
  *   Initialize page structure and memory free list. The 'pages' array has one 'struct Page' entry
- * per physical page. Pages are reference counted, and free pages are kept on a linked list.
+ * per physical page. Pages are reference counted, and free pages are kept in blocks by the buddy
+ * allocator.
  *
- * Hint: Use 'LIST_INSERT_HEAD' to insert free pages to 'page_free_list'.
+ * Hint: Use 'page_free' to add free pages to 'page_free_list': adjacent ones coalesce into blocks.
  */
 void page_init(void) {
 	/* Step 1: Initialize page_free_list. */
 	/* Hint: Use macro `LIST_INIT` defined in include/queue.h. */
 	/* Exercise 2.3: Your code here. (1/4) */
-	LIST_INIT(&page_free_list);
+	for (int order = 0; order <= PAGE_MAX_ORDER; order++) {
+		LIST_INIT(&page_free_list[order]);
+	}
+	LIST_INIT(&page_zero_pool);
+	page_zero_count = 0;
 	/* Step 2: Align `freemem` up to multiple of PAGE_SIZE. */
 	/* Exercise 2.3: Your code here. (2/4) */
 	freemem = ROUND(freemem, PAGE_SIZE);
@@ -108,10 +119,153 @@ void page_init(void) {
 	/* Exercise 2.3: Your code here. (4/4) */
 	for (u_long i = size; i < npage; i++, pageptr++) {
 		pageptr->pp_ref = 0;
-		LIST_INSERT_HEAD(&page_free_list, pageptr, pp_link);
+		page_free(pageptr);
+	}
+}
+
+/* Overview:
+ *   Put the free block of 2^'order' pages at 'pp' on its free list.
+ */
+static void buddy_insert(struct Page *pp, u_int order) {
+	pp->pp_order = order;
+	pp->pp_free = PAGE_FREE;
+	LIST_INSERT_HEAD(&page_free_list[order], pp, pp_link);
+}
+
+/* Overview:
+ *   Take the free block at 'pp' off its free list.
+ */
+static void buddy_remove(struct Page *pp) {
+	LIST_REMOVE(pp, pp_link);
+	pp->pp_free = 0;
+}
+
+/* Overview:
+ *   Take a free block of 2^'order' pages off the free lists, splitting the smallest free block
+ *   large enough in halves, the upper ones being freed, until its order is 'order'.
+ *
+ * Post-Condition:
+ *   Return the first 'Page' of the block, or NULL if there is no free block large enough.
+ */
+static struct Page *buddy_alloc(u_int order) {
+	struct Page *pp;
+	u_int o;
+
+	for (o = order; o <= PAGE_MAX_ORDER && LIST_EMPTY(&page_free_list[o]); o++) {
+	}
+	if (o > PAGE_MAX_ORDER) {
+		return NULL;
+	}
+	pp = LIST_FIRST(&page_free_list[o]);
+	buddy_remove(pp);
+	while (o > order) {
+		o--;
+		buddy_insert(pp + (1 << o), o);
+	}
+	return pp;
+}
+
+/* Overview:
+ *   Take a page off 'page_zero_pool'.
+ *
+ * Post-Condition:
+ *   Return the page, which is filled with zero, or NULL if the pool is empty.
+ */
+static struct Page *page_zero_get(void) {
+	struct Page *pp;
+
+	if ((pp = LIST_FIRST(&page_zero_pool)) != NULL) {
+		LIST_REMOVE(pp, pp_link);
+		pp->pp_free = 0;
+		page_zero_count--;
+	}
+	return pp;
+}
+
+/* Overview:
+ *   Give all the pages of 'page_zero_pool' back to the buddy allocator, so that they coalesce.
+ */
+static void page_zero_drain(void) {
+	struct Page *pp;
+
+	while ((pp = page_zero_get()) != NULL) {
+		page_free_order(pp, 0);
 	}
 }
 
+/* Overview:
+ *   Zero a free page into 'page_zero_pool', unless it is full. Called when the CPU is idle, so
+ *   that the pages allocated by 'page_alloc' later need not be zeroed then.
+ *
+ * Post-Condition:
+ *   Return non-zero if a page was added and the pool is not full yet, or 0 otherwise.
+ */
+int page_zero_refill(void) {
+	struct Page *pp;
+
+	if (page_zero_count >= PAGE_ZERO_POOL || (pp = buddy_alloc(0)) == NULL) {
+		return 0;
+	}
+	memset((void *)page2kva(pp), 0, PAGE_SIZE);
+	pp->pp_free = PAGE_ZEROED;
+	LIST_INSERT_HEAD(&page_zero_pool, pp, pp_link);
+	return ++page_zero_count < PAGE_ZERO_POOL;
+}
+
+/* Overview:
+ *   Allocate a block of 2^'order' physically contiguous pages, aligned on its size, and fill it
+ *   with zero.
+ *
+ * Post-Condition:
+ *   If there is no free block large enough, return -E_NO_MEM.
+ *   Otherwise, set the address of the first 'Page' of the block to *pp, and return 0.
+ *
+ * Note:
+ *   As with 'page_alloc', the reference counts of the pages are not increased. The block is freed
+ *   with 'page_free_order', or page by page with 'page_free'.
+ *
+ * Hint:
+ *   The pages of 'page_zero_pool' may be what keeps a large enough block from forming: give them
+ *   back before failing.
+ */
+int page_alloc_order(struct Page **new, u_int order) {
+	struct Page *pp;
+
+	if ((pp = buddy_alloc(order)) == NULL && page_zero_count > 0) {
+		page_zero_drain();
+		pp = buddy_alloc(order);
+	}
+	if (pp == NULL) {
+		return -E_NO_MEM;
+	}
+	memset((void *)page2kva(pp), 0, PAGE_SIZE << order);
+	*new = pp;
+	return 0;
+}
+
+/* Overview:
+ *   Release the block of 2^'order' pages at 'pp', coalescing it with its buddy (the block it was
+ *   split from) as long as that is free too.
+ *
+ * Pre-Condition:
+ *   The 'pp_ref' of all pages in the block is '0'. 'pp' is aligned on 2^'order' pages.
+ */
+void page_free_order(struct Page *pp, u_int order) {
+	u_long ppn = page2ppn(pp), buddy;
+
+	assert(pp->pp_ref == 0 && (ppn & ((1 << order) - 1)) == 0);
+	for (; order < PAGE_MAX_ORDER; order++) {
+		buddy = ppn ^ (1 << order);
+		if (buddy >= npage || pages[buddy].pp_free != PAGE_FREE ||
+		    pages[buddy].pp_order != order) {
+			break;
+		}
+		buddy_remove(&pages[buddy]);
+		ppn &= ~(1 << order);
+	}
+	buddy_insert(&pages[ppn], order);
+}
+
 /* Overview:
  *   Allocate a physical page from free memory, and fill this page with zero.
  *
@@ -123,23 +277,29 @@ void page_init(void) {
  *   This does NOT increase the reference count 'pp_ref' of the page - the caller must do these if
  *   necessary (either explicitly or via page_insert).
  *
- * Hint: Use LIST_FIRST and LIST_REMOVE defined in include/queue.h.
+ * Hint:
+ *   A page zeroed ahead of time is taken from 'page_zero_pool' if there is one.
  */
 int page_alloc(struct Page **new) {
-	/* Step 1: Get a page from free memory. If fails, return the error code.*/
-	struct Page *pp;
-	/* Exercise 2.4: Your code here. (1/2) */
-	if (LIST_EMPTY(&page_free_list)) {
-		return -4; // E_NO_MEM defined in include/error.h
+	if ((*new = page_zero_get()) != NULL) {
+		return 0;
 	}
-	pp = LIST_FIRST(&page_free_list);
-	LIST_REMOVE(pp, pp_link);
+	return page_alloc_order(new, 0);
+}
 
-	/* Step 2: Initialize this page with zero.
-	 * Hint: use `memset`. */
-	/* Exercise 2.4: Your code here. (2/2) */
-	memset((void *)page2kva(pp), 0, PAGE_SIZE);
-	*new = pp;
+/* Overview:
+ *   Allocate a physical page from free memory like 'page_alloc', but leave its contents as they
+ *   are, for a caller that overwrites the whole page. Pages zeroed ahead of time are only used
+ *   when there is no other free page.
+ *
+ * Post-Condition:
+ *   If failed to allocate a new page (out of memory, there's no free page), return -E_NO_MEM.
+ *   Otherwise, set the address of the allocated 'Page' to *pp, and return 0.
+ */
+int page_alloc_nozero(struct Page **new) {
+	if ((*new = buddy_alloc(0)) == NULL && (*new = page_zero_get()) == NULL) {
+		return -E_NO_MEM;
+	}
 	return 0;
 }
 
@@ -150,10 +310,7 @@ int page_alloc(struct Page **new) {
  *   'pp->pp_ref' is '0'.
  */
 void page_free(struct Page *pp) {
-	assert(pp->pp_ref == 0);
-	/* Just insert it into 'page_free_list'. */
-	/* Exercise 2.5: Your code here. */
-	LIST_INSERT_HEAD(&page_free_list, pp, pp_link);
+	page_free_order(pp, 0);
 }
 
 /* Overview:
@@ -205,6 +362,21 @@ static int pgdir_walk(Pde *pgdir, u_long va, int create, Pte **ppte) {
 	return 0;
 }
 
+/* Overview:
+ *   Turn the large page containing 'va', of which '*pte' is an entry, into ordinary pages (the
+ *   same mappings without 'PTE_LARGE'), before that entry is changed.
+ */
+static void page_split_large(u_int asid, u_long va, Pte *pte) {
+	Pte *first = pte - (PTX(va) & (LARGE_NPAGES - 1));
+	u_int i;
+
+	for (i = 0; i < LARGE_NPAGES; i++) {
+		first[i] &= ~PTE_LARGE;
+	}
+	// The TLB entry of a large page matches any address in it.
+	tlb_invalidate(asid, va);
+}
+
 /* Overview:
  *   Map the physical page 'pp' at virtual address 'va'. The permission (the low 12 bits) of the
  *   page table entry should be set to 'perm | PTE_C_CACHEABLE | PTE_V'.
@@ -220,10 +392,16 @@ static int pgdir_walk(Pde *pgdir, u_long va, int create, Pte **ppte) {
 int page_insert(Pde *pgdir, u_int asid, struct Page *pp, u_long va, u_int perm) {
 	Pte *pte;
 
+	// Large pages are only mapped by 'page_insert_large'.
+	perm &= ~PTE_LARGE;
+
 	/* Step 1: Get corresponding page table entry. */
 	pgdir_walk(pgdir, va, 0, &pte);
 
 	if (pte && (*pte & PTE_V)) {
+		if (*pte & PTE_LARGE) {
+			page_split_large(asid, va, pte);
+		}
 		if (pa2page(*pte) != pp) {
 			page_remove(pgdir, asid, va);
 		} else {
@@ -250,6 +428,34 @@ int page_insert(Pde *pgdir, u_int asid, struct Page *pp, u_long va, u_int perm)
 	return 0;
 }
 
+/* Overview:
+ *   Map the block of 'LARGE_NPAGES' physical pages at 'pp' as a large page at virtual address
+ *   'va', with 'perm'. Each page of the block is mapped (and referenced) as with 'page_insert'.
+ *
+ * Pre-Condition:
+ *   'va' and the physical address of 'pp' are aligned on 'LARGE_PAGE_SIZE' (e.g. 'pp' is from
+ *   'page_alloc_order' with order 'LARGE_PAGE_ORDER').
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_NO_MEM, if the page table couldn't be allocated. Nothing is mapped then.
+ */
+int page_insert_large(Pde *pgdir, u_int asid, struct Page *pp, u_long va, u_int perm) {
+	Pte *pte;
+	u_int i;
+
+	assert(va % LARGE_PAGE_SIZE == 0 && page2pa(pp) % LARGE_PAGE_SIZE == 0);
+	// The pages share a page table: only the first insertion may have to allocate it.
+	for (i = 0; i < LARGE_NPAGES; i++) {
+		try(page_insert(pgdir, asid, pp + i, va + i * PAGE_SIZE, perm));
+	}
+	pgdir_walk(pgdir, va, 0, &pte);
+	for (i = 0; i < LARGE_NPAGES; i++) {
+		pte[i] |= PTE_LARGE;
+	}
+	return 0;
+}
+
 /* Lab 2 Key Code "page_lookup" */
 /*Overview:
     Look up the Page that virtual address `va` map to.
@@ -304,6 +510,10 @@ void page_remove(Pde *pgdir, u_int asid, u_long va) {
 		return;
 	}
 
+	if (*pte & PTE_LARGE) {
+		page_split_large(asid, va, pte);
+	}
+
 	/* Step 2: Decrease reference count on 'pp'. */
 	page_decref(pp);
 
@@ -314,6 +524,192 @@ void page_remove(Pde *pgdir, u_int asid, u_long va) {
 }
 /* End of Key Code "page_remove" */
 
+/*
+ * The range operations below change the mappings of many consecutive pages at once: each page
+ * table is looked up once rather than once per page, page tables missing from a range are skipped
+ * whole, and the TLB is invalidated once for the range at the end (see 'tlb_invalidate_range').
+ */
+
+/* Overview:
+ *   Return the page table mapping 'va' in 'pgdir', or NULL if there is none.
+ */
+static Pte *pgdir_table(Pde *pgdir, u_long va) {
+	Pde pde = pgdir[PDX(va)];
+
+	return (pde & PTE_V) ? (Pte *)KADDR(PTE_ADDR(pde)) : NULL;
+}
+
+/* Overview:
+ *   Return the end of the part of [va, end) mapped by the page table of 'va'.
+ */
+static inline u_long table_end(u_long va, u_long end) {
+	return MIN(ROUNDDOWN(va, PDMAP) + PDMAP, end);
+}
+
+/* Overview:
+ *   Unmap the page mapped by the entry 'pte' of 'va', if any, without invalidating the TLB.
+ */
+static void pte_remove(u_int asid, u_long va, Pte *pte) {
+	if (!(*pte & PTE_V)) {
+		return;
+	}
+	if (*pte & PTE_LARGE) {
+		page_split_large(asid, va, pte);
+	}
+	page_decref(pa2page(*pte));
+	*pte = 0;
+}
+
+/* Overview:
+ *   Map 'pp' with 'perm' by the entry 'pte' of 'va', replacing its old mapping, without
+ *   invalidating the TLB.
+ */
+static void pte_insert(u_int asid, u_long va, Pte *pte, struct Page *pp, u_int perm) {
+	// Referenced first, in case 'pp' is the page mapped already.
+	pp->pp_ref++;
+	pte_remove(asid, va, pte);
+	*pte = page2pa(pp) | (perm & ~PTE_LARGE) | PTE_C_CACHEABLE | PTE_V;
+}
+
+/* Overview:
+ *   Allocate 'npages' pages and map them from 'va' on with 'perm', as 'page_alloc' and
+ *   'page_insert' would for each page, replacing the old mappings.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_NO_MEM, if out of memory. The pages allocated until then stay mapped.
+ */
+int page_alloc_range(Pde *pgdir, u_int asid, u_long va, u_int npages, u_int perm) {
+	u_long end = va + npages * PAGE_SIZE, v, next;
+	struct Page *pp;
+	Pte *pt;
+	int r = 0;
+
+	for (v = va; v < end && r == 0;) {
+		next = table_end(v, end);
+		if ((r = pgdir_walk(pgdir, v, 1, &pt)) != 0) {
+			break;
+		}
+		pt -= PTX(v);
+		for (; v < next; v += PAGE_SIZE) {
+			if ((r = page_alloc(&pp)) != 0) {
+				break;
+			}
+			pte_insert(asid, v, pt + PTX(v), pp, perm);
+		}
+	}
+	tlb_invalidate_range(asid, va, (v - va) / PAGE_SIZE);
+	return r;
+}
+
+/* Overview:
+ *   Map the pages mapped in 'src' from 'srcva' on, for 'npages' pages, at the same offsets from
+ *   'dstva' on in 'dst', replacing the old mappings there. Unmapped pages of the source are
+ *   skipped. Each page keeps its permission, except as 'flags' says:
+ *   - 'MAP_LIBRARY': only the pages with 'PTE_LIBRARY' are mapped.
+ *   - 'MAP_COW': the writable pages without 'PTE_LIBRARY' are mapped with 'PTE_COW' instead of
+ *     'PTE_D', and remapped so in 'src' as well (after being mapped in 'dst', as 'fork' does).
+ *     The pages with 'PTE_PRIVATE' are not mapped.
+ *
+ * Pre-Condition:
+ *   If 'src' and 'dst' are the same, the two ranges do not overlap unless they are the same.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_NO_MEM, if a page table couldn't be allocated. The pages mapped until then stay
+ *   mapped.
+ */
+int page_map_range(Pde *src, u_int srcasid, u_long srcva, Pde *dst, u_int dstasid, u_long dstva,
+		   u_int npages, u_int flags) {
+	u_long end = srcva + npages * PAGE_SIZE, v, next, dv, dpdx = ~0;
+	u_int perm, ncow = 0;
+	Pte *spt, *spte, *dpt = NULL;
+	int r = 0;
+
+	for (v = srcva; v < end && r == 0;) {
+		next = table_end(v, end);
+		if ((spt = pgdir_table(src, v)) == NULL) {
+			v = next;
+			continue;
+		}
+		for (; v < next; v += PAGE_SIZE) {
+			spte = spt + PTX(v);
+			perm = PTE_FLAGS(*spte);
+			if (!(perm & PTE_V) || ((flags & MAP_LIBRARY) && !(perm & PTE_LIBRARY)) ||
+			    ((flags & MAP_COW) && (perm & PTE_PRIVATE))) {
+				continue;
+			}
+			dv = dstva + (v - srcva);
+			if (PDX(dv) != dpdx) {
+				if ((r = pgdir_walk(dst, dv, 1, &dpt)) != 0) {
+					break;
+				}
+				dpt -= PTX(dv);
+				dpdx = PDX(dv);
+			}
+			if ((flags & MAP_COW) && (perm & PTE_D) && !(perm & PTE_LIBRARY)) {
+				perm = (perm & ~PTE_D) | PTE_COW;
+				pte_insert(dstasid, dv, dpt + PTX(dv), pa2page(*spte), perm);
+				if (*spte & PTE_LARGE) {
+					page_split_large(srcasid, v, spte);
+				}
+				*spte = (*spte & ~PTE_D) | PTE_COW;
+				ncow++;
+			} else {
+				pte_insert(dstasid, dv, dpt + PTX(dv), pa2page(*spte), perm);
+			}
+		}
+	}
+	tlb_invalidate_range(dstasid, dstva, (v - srcva) / PAGE_SIZE);
+	if (ncow > 0) {
+		tlb_invalidate_range(srcasid, srcva, (v - srcva) / PAGE_SIZE);
+	}
+	return r;
+}
+
+/* Overview:
+ *   Unmap the pages mapped from 'va' on, for 'npages' pages, as 'page_remove' would for each.
+ */
+void page_remove_range(Pde *pgdir, u_int asid, u_long va, u_int npages) {
+	u_long end = va + npages * PAGE_SIZE, v, next;
+	Pte *pt;
+
+	for (v = va; v < end; v = next) {
+		next = table_end(v, end);
+		if ((pt = pgdir_table(pgdir, v)) == NULL) {
+			continue;
+		}
+		for (; v < next; v += PAGE_SIZE) {
+			pte_remove(asid, v, pt + PTX(v));
+		}
+	}
+	tlb_invalidate_range(asid, va, npages);
+}
+
+/* Overview:
+ *   Allocate all the free pages into 'fl', leaving no free memory (for tests).
+ */
+void page_steal_all(struct Page_list *fl) {
+	struct Page *pp;
+
+	LIST_INIT(fl);
+	while (page_alloc(&pp) == 0) {
+		LIST_INSERT_HEAD(fl, pp, pp_link);
+	}
+}
+
+/* Overview:
+ *   Free the pages taken by 'page_steal_all' into 'fl'.
+ */
+void page_free_all(struct Page_list *fl) {
+	struct Page *pp;
+
+	while ((pp = LIST_FIRST(fl)) != NULL) {
+		LIST_REMOVE(pp, pp_link);
+		page_free(pp);
+	}
+}
+
 void physical_memory_manage_check(void) {
 	struct Page *pp, *pp0, *pp1, *pp2;
 	struct Page_list fl;
@@ -330,9 +726,7 @@ void physical_memory_manage_check(void) {
 	assert(pp2 && pp2 != pp1 && pp2 != pp0);
 
 	// temporarily steal the rest of the free pages
-	fl = page_free_list;
-	// now this page_free list must be empty!!!!
-	LIST_INIT(&page_free_list);
+	page_steal_all(&fl);
 	// should be no free memory
 	assert(page_alloc(&pp) == -E_NO_MEM);
 
@@ -352,7 +746,7 @@ void physical_memory_manage_check(void) {
 	// pp0 should be zero
 	assert(*temp == 0);
 
-	page_free_list = fl;
+	page_free_all(&fl);
 	page_free(pp0);
 	page_free(pp1);
 	page_free(pp2);
@@ -418,9 +812,7 @@ void page_check(void) {
 	assert(pp2 && pp2 != pp1 && pp2 != pp0);
 
 	// temporarily steal the rest of the free pages
-	fl = page_free_list;
-	// now this page_free list must be empty!!!!
-	LIST_INIT(&page_free_list);
+	page_steal_all(&fl);
 
 	// should be no free memory
 	assert(page_alloc(&pp) == -E_NO_MEM);
@@ -504,7 +896,7 @@ void page_check(void) {
 	pp0->pp_ref = 0;
 
 	// give free list back
-	page_free_list = fl;
+	page_free_all(&fl);
 
 	// free the pages we took
 	page_free(pp0);
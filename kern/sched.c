@@ -1,20 +1,214 @@
 #include <env.h>
+#include <kclock.h>
 #include <pmap.h>
 #include <printk.h>
+#include <sched.h>
+
+/*
+ * Under SCHED_RR and SCHED_STRIDE only 'env_sched_list[0]' is used. Under SCHED_MLFQ
+ * 'env_sched_list[i]' holds the runnable envs of level 'i', and bit 'i' of 'sched_ready' is set
+ * iff that list is not empty, so the highest non-empty level is found in O(1).
+ */
+static u_int sched_ready;
+
+#if MOS_SCHED_POLICY == SCHED_MLFQ
+// Incremented by every priority boost. An env whose 'env_sched_epoch' is older has been boosted.
+// Epoch 0 is never current, so envs allocated with 'env_sched_epoch' 0 start at level 0.
+static u_int sched_epoch = 1;
+#endif
+
+#if MOS_SCHED_POLICY == SCHED_STRIDE
+// Under SCHED_STRIDE, the pass of the last env picked. No runnable env has a smaller pass.
+static u_int sched_vtime;
+#endif
+
+// CP0_COUNT value when 'curenv' was dispatched or last charged under SCHED_STRIDE.
+static u_int sched_stamp;
+
+// Whether some env waits for a wakeup that has to be polled on every tick (see 'cons_poll').
+static int sched_polling;
+
+// The stride of an env of weight 1. An env of weight 'w' advances its pass by 'STRIDE1 / w' per
+// tick.
+#define STRIDE1 (1 << 20)
+
+#if MOS_SCHED_POLICY == SCHED_MLFQ
+/* Overview:
+ *   Return the number of time slices an env may use up at MLFQ level 'level' before being
+ *   demoted. Lower levels get exponentially longer allotments.
+ */
+static inline u_int sched_quantum(struct Env *e, u_int level) {
+	return (e->env_pri ? e->env_pri : 1) << level;
+}
+
+/* Overview:
+ *   Bring 'e->env_sched_level' up to date with the boosts performed since it was set.
+ *
+ * Hint:
+ *   A boost does not touch each env: it just bumps 'sched_epoch', so the level of every env set
+ *   before that is lazily reset to 0 here.
+ */
+static void sched_sync(struct Env *e) {
+	if (e->env_sched_epoch != sched_epoch) {
+		e->env_sched_epoch = sched_epoch;
+		e->env_sched_level = 0;
+		e->env_sched_ticks = sched_quantum(e, 0);
+	}
+}
+
+/* Overview:
+ *   Move 'e' (runnable or not) to MLFQ level 'level' with a fresh allotment. If 'e' is runnable,
+ *   it is requeued at the tail of its new level.
+ */
+static void sched_set_level(struct Env *e, u_int level) {
+	int runnable = e->env_status == ENV_RUNNABLE;
+
+	if (runnable) {
+		sched_remove(e);
+	}
+	e->env_sched_level = level;
+	e->env_sched_ticks = sched_quantum(e, level);
+	if (runnable) {
+		sched_insert(e, 0);
+	}
+}
+
+#endif
+
+#if MOS_SCHED_POLICY == SCHED_STRIDE
+/* Overview:
+ *   Bring the pass of 'e', which is becoming runnable, within one stride of 'sched_vtime'.
+ *
+ * Hint:
+ *   An env that has been blocked must not have banked the CPU time it didn't use, or it would
+ *   monopolize the CPU once woken up. Passes are compared modulo 2^32, so an env that was never
+ *   scheduled (pass 0) is also caught here.
+ */
+static void sched_stride_sync(struct Env *e) {
+	u_int lag = e->env_stride_pass - sched_vtime;
+
+	if ((int)lag < 0 || lag > STRIDE1) {
+		e->env_stride_pass = sched_vtime;
+	}
+}
+#endif
+
+/* Overview:
+ *   Insert a runnable env into the run queue of its level, at the head if 'head' is set.
+ *
+ * Pre-Condition:
+ *   'e' is not in any run queue.
+ */
+void sched_insert(struct Env *e, int head) {
+	u_int level = 0;
+
+#if MOS_SCHED_POLICY == SCHED_MLFQ
+	sched_sync(e);
+	level = e->env_sched_level;
+#elif MOS_SCHED_POLICY == SCHED_STRIDE
+	sched_stride_sync(e);
+#endif
+	if (head) {
+		TAILQ_INSERT_HEAD(&env_sched_list[level], e, env_sched_link);
+	} else {
+		TAILQ_INSERT_TAIL(&env_sched_list[level], e, env_sched_link);
+	}
+	sched_ready |= 1 << level;
+}
 
 /* Overview:
- *   Implement a round-robin scheduling to select a runnable env and schedule it using 'env_run'.
+ *   Remove an env from its run queue.
+ *
+ * Pre-Condition:
+ *   'e' is in a run queue (i.e. 'e->env_status' is 'ENV_RUNNABLE').
+ */
+void sched_remove(struct Env *e) {
+	u_int level = 0;
+
+#if MOS_SCHED_POLICY == SCHED_MLFQ
+	sched_sync(e);
+	level = e->env_sched_level;
+#endif
+	TAILQ_REMOVE(&env_sched_list[level], e, env_sched_link);
+	if (TAILQ_EMPTY(&env_sched_list[level])) {
+		sched_ready &= ~(1 << level);
+	}
+}
+
+/* Overview:
+ *   Block 'curenv' on the wait list 'wl': it leaves the run queue until 'sched_wakeup' is called on
+ *   it. The caller should then give up the CPU with 'schedule(1)'.
+ *   If 'wl' is NULL, 'curenv' is only woken up by its timer (see 'kclock_arm').
+ */
+void sched_block(struct Env_wait_list *wl) {
+	sched_remove(curenv);
+	curenv->env_status = ENV_NOT_RUNNABLE;
+	if (wl != NULL) {
+		TAILQ_INSERT_TAIL(wl, curenv, env_wait_link);
+	}
+	curenv->env_wait_list = wl;
+}
+
+/* Overview:
+ *   Wake up 'e', which is blocked on a wait list, making its pending syscall return 'ret'.
+ */
+void sched_wakeup(struct Env *e, u_int ret) {
+	// The context of 'curenv' still lives on the kernel stack until it is switched out.
+	struct Trapframe *tf = e == curenv ? (struct Trapframe *)KSTACKTOP - 1 : &e->env_tf;
+
+	sched_wait_cancel(e);
+	tf->regs[2] = ret;
+	e->env_status = ENV_RUNNABLE;
+	sched_insert(e, 0);
+}
+
+/* Overview:
+ *   Move 'e', which is blocked, from the wait list it is blocked on (if any) to the wait list 'wl'.
+ */
+void sched_wait_move(struct Env *e, struct Env_wait_list *wl) {
+	if (e->env_wait_list != NULL) {
+		TAILQ_REMOVE(e->env_wait_list, e, env_wait_link);
+	}
+	TAILQ_INSERT_TAIL(wl, e, env_wait_link);
+	e->env_wait_list = wl;
+}
+
+/* Overview:
+ *   Remove 'e' from the wait list it is blocked on and disarm its timer, if any, without making it
+ *   runnable.
+ */
+void sched_wait_cancel(struct Env *e) {
+	if (e->env_wait_list != NULL) {
+		TAILQ_REMOVE(e->env_wait_list, e, env_wait_link);
+		e->env_wait_list = NULL;
+	}
+	kclock_cancel(e);
+}
+
+#if MOS_SCHED_POLICY == SCHED_MLFQ
+/* Overview:
+ *   Move every runnable env to the highest level, so that envs stuck at low levels behind
+ *   interactive ones cannot starve. Blocked envs are boosted lazily by 'sched_sync'.
+ */
+static void sched_boost(void) {
+	for (int i = 1; i < NSCHED_LEVEL; i++) {
+		TAILQ_CONCAT(&env_sched_list[0], &env_sched_list[i], env_sched_link);
+	}
+	sched_ready = TAILQ_EMPTY(&env_sched_list[0]) ? 0 : 1;
+	sched_epoch++;
+}
+#endif
+
+#if MOS_SCHED_POLICY == SCHED_RR
+/* Overview:
+ *   Pick the next env with the round-robin policy.
  *
  * Post-Condition:
  *   If 'yield' is set (non-zero), 'curenv' should not be scheduled again unless it is the only
  *   runnable env.
- *
- * Hints:
- *   1. The variable 'count' used for counting slices should be defined as 'static'.
- *   2. Use variable 'env_sched_list', which contains and only contains all runnable envs.
- *   3. You shouldn't use any 'return' statement because this function is 'noreturn'.
+ *   Returns NULL if there is no runnable env.
  */
-void schedule(int yield) {
+static struct Env *sched_pick_rr(int yield) {
 	static int count = 0; // remaining time slices of current env
 	struct Env *e = curenv;
 
@@ -30,22 +224,275 @@ void schedule(int yield) {
 	 * head env repeatedly.)
 	 *
 	 * Otherwise, we simply schedule 'e' again.
-	 *
-	 * You may want to use macros below:
-	 *   'TAILQ_FIRST', 'TAILQ_REMOVE', 'TAILQ_INSERT_TAIL'
 	 */
-	/* Exercise 3.12: Your code here. */
 	if (yield || count <= 0 || e == NULL || e->env_status != ENV_RUNNABLE) {
 		if (e != NULL && e->env_status == ENV_RUNNABLE) {
-			TAILQ_REMOVE(&env_sched_list, e, env_sched_link);
-			TAILQ_INSERT_TAIL(&env_sched_list, e, env_sched_link);
+			sched_remove(e);
+			sched_insert(e, 0);
 		}
-		e = TAILQ_FIRST(&env_sched_list);
+		e = TAILQ_FIRST(&env_sched_list[0]);
 		if (e == NULL) {
-			panic("schedule: no runnable envs\n");
+			return NULL;
 		}
 		count = e->env_pri;
 	}
 	count--;
+	return e;
+}
+
+#endif
+
+#if MOS_SCHED_POLICY == SCHED_MLFQ
+/* Overview:
+ *   Pick the next env with the multi-level feedback queue policy.
+ *
+ *   - An env that uses up its allotment at a level is demoted one level.
+ *   - An env that yields or blocks before using up its allotment is promoted one level.
+ *   - A running env is preempted as soon as a higher level becomes non-empty.
+ *   - Envs of the same level take turns at the end of each time slice.
+ *   - Every 'SCHED_BOOST_TICKS' ticks all envs are boosted to level 0.
+ *
+ *   Returns NULL if there is no runnable env.
+ *
+ * Hint:
+ *   'expired' is set if the time slice of 'curenv' is used up, 'yield' if 'curenv' gives up the
+ *   CPU. If neither is set, a timer interrupt arrived in the middle of the slice.
+ */
+static struct Env *sched_pick_mlfq(int yield, int expired) {
+	static u_int boost_at = 0;
+	struct Env *e = curenv;
+
+	if (kclock_jiffies - boost_at >= SCHED_BOOST_TICKS) {
+		boost_at = kclock_jiffies;
+		sched_boost();
+	}
+
+	if (e != NULL) {
+		sched_sync(e);
+		if (expired && e->env_sched_ticks > 0) {
+			e->env_sched_ticks--;
+		}
+		if (e->env_sched_ticks == 0) {
+			sched_set_level(e, MIN(e->env_sched_level + 1, NSCHED_LEVEL - 1));
+		} else if (yield) {
+			sched_set_level(e, e->env_sched_level == 0 ? 0 : e->env_sched_level - 1);
+		} else if (e->env_status == ENV_RUNNABLE &&
+			   (sched_ready & ((1 << e->env_sched_level) - 1)) == 0) {
+			// Nothing of higher priority is ready: keep running the current slice.
+			if (!expired) {
+				return e;
+			}
+			sched_remove(e);
+			sched_insert(e, 0);
+		}
+	}
+
+	if (sched_ready == 0) {
+		return NULL;
+	}
+	return TAILQ_FIRST(&env_sched_list[__builtin_ctz(sched_ready)]);
+}
+
+#endif
+
+#if MOS_SCHED_POLICY == SCHED_STRIDE
+/* Overview:
+ *   Charge 'curenv' for the CPU time used since it was last dispatched or charged: a full
+ *   stride 'STRIDE1 / env_pri' per tick, in steps of 1/64 of a tick.
+ */
+static void sched_stride_charge(void) {
+	u_int now = kclock_count();
+	u_int steps = (now - sched_stamp) / (TIMER_INTERVAL >> 6);
+
+	curenv->env_stride_pass += (STRIDE1 / (curenv->env_pri ? curenv->env_pri : 1) >> 6) * steps;
+	sched_stamp += steps * (TIMER_INTERVAL >> 6);
+}
+
+/* Overview:
+ *   Pick the next env with the stride scheduling policy: the runnable env with the smallest pass.
+ *   Each env is charged for the CPU time it uses, so over time each env gets a share of the CPU
+ *   proportional to its weight 'env_pri'.
+ *   Returns NULL if there is no runnable env.
+ *
+ * Hint:
+ *   Ties are broken in favor of 'curenv' (unless it yields), to avoid needless switches. See
+ *   'sched_pick_mlfq' for 'yield' and 'expired'.
+ */
+static struct Env *sched_pick_stride(int yield, int expired) {
+	struct Env *e = curenv, *min = NULL, *it;
+
+	if (e != NULL) {
+		sched_stride_charge();
+		if (!yield && e->env_status == ENV_RUNNABLE) {
+			if (!expired) {
+				return e;
+			}
+			min = e;
+		}
+	}
+	TAILQ_FOREACH (it, &env_sched_list[0], env_sched_link) {
+		if (yield && it == e) {
+			continue;
+		}
+		if (min == NULL || (int)(it->env_stride_pass - min->env_stride_pass) < 0) {
+			min = it;
+		}
+	}
+	if (min == NULL && yield && e != NULL && e->env_status == ENV_RUNNABLE) {
+		// 'curenv' is the only runnable env.
+		min = e;
+	}
+	if (min != NULL) {
+		sched_vtime = min->env_stride_pass;
+	}
+	return min;
+}
+#endif
+
+#if MOS_SCHED_POLICY != SCHED_RR
+/* Overview:
+ *   Adapt the time slice length of 'e', which is switched out or continues with a new slice:
+ *   envs that use up their slice get a twice longer one (fewer timer interrupts for batch jobs),
+ *   envs that give up the CPU early a twice shorter one (quicker preemption of interactive ones).
+ */
+static void sched_adapt(struct Env *e, int yield, int expired) {
+	if (expired) {
+		e->env_quantum_order = MIN(e->env_quantum_order + 1, SCHED_QUANTUM_MAX_ORDER);
+	} else if (yield && e->env_quantum_order > 0) {
+		e->env_quantum_order--;
+	}
+}
+#endif
+
+extern void env_idle(void) __attribute__((noreturn));
+
+/* Overview:
+ *   Return non-zero if the timer interrupt ending the idle period (at 'kclock_compare') is due.
+ */
+static inline int sched_idle_over(void) {
+	return (int)(kclock_count() - kclock_compare) >= 0;
+}
+
+/* Overview:
+ *   Idle the CPU until an interrupt arrives, when no env is runnable. The timer is armed for the
+ *   next tick if some wakeup source has to be polled ('poll' is set), or else for the next expiring
+ *   timer. Until then, free pages are zeroed ahead for 'page_alloc' (see 'page_zero_refill').
+ *
+ * Post-Condition:
+ *   The context of 'curenv' (if any) is saved and 'curenv' is set to NULL, so that the interrupt
+ *   that ends the idle period reschedules from scratch.
+ */
+static void __attribute__((noreturn)) sched_idle(int poll) {
+	if (curenv != NULL) {
+		curenv->env_tf = *((struct Trapframe *)KSTACKTOP - 1);
+		kclock_leave_kernel();
+		curenv = NULL;
+	}
+	kclock_set_idle(poll);
+	while (!sched_idle_over() && page_zero_refill()) {
+	}
+	env_idle();
+}
+
+/* Overview:
+ *   Select a runnable env with the configured policy and schedule it using 'env_run'.
+ *   If no env is runnable but some env is waiting for a wakeup, idle until the next interrupt.
+ *
+ *   Under SCHED_RR the timer interrupts on every tick, and each tick is a time slice. The other
+ *   policies give each env an adaptive time slice (see 'sched_adapt'), and the timer interrupts at
+ *   the end of the slice, or at the next tick with something to wake up if that comes first.
+ *
+ * Hints:
+ *   1. 'env_sched_list' contains and only contains all runnable envs.
+ *   2. You shouldn't use any 'return' statement because this function is 'noreturn'.
+ */
+void schedule(int yield) {
+	struct Env *prev = curenv, *e;
+#if MOS_SCHED_POLICY != SCHED_RR
+	int expired = !yield && (prev == NULL || kclock_slice_expired());
+#endif
+
+	if (prev != NULL) {
+		// A handoff is only worth it if 'curenv' blocks without being scheduled in between.
+		prev->env_ipc_handoff = 0;
+		if (!yield) {
+			prev->env_nintr++;
+		}
+	}
+	kclock_update();
+#if !defined(LAB) || LAB >= 4
+	sched_polling = cons_poll();
+#endif
+#if MOS_SCHED_POLICY == SCHED_MLFQ
+	e = sched_pick_mlfq(yield, expired);
+#elif MOS_SCHED_POLICY == SCHED_STRIDE
+	e = sched_pick_stride(yield, expired);
+#else
+	e = sched_pick_rr(yield);
+#endif
+	if (prev != NULL && e != prev) {
+		if (yield || prev->env_status != ENV_RUNNABLE) {
+			prev->env_nvcsw++;
+		} else {
+			prev->env_nivcsw++;
+		}
+	}
+	if (e == NULL) {
+		if (!sched_polling && !kclock_pending()) {
+			panic("schedule: no runnable envs\n");
+		}
+		sched_idle(sched_polling);
+	}
+#if MOS_SCHED_POLICY != SCHED_RR
+	if (prev != NULL) {
+		sched_adapt(prev, yield, expired);
+	}
+	if (e != prev || expired) {
+		kclock_start_slice(SCHED_QUANTUM_MIN << e->env_quantum_order);
+	}
+	kclock_arm_slice(sched_polling);
+#endif
+	sched_stamp = kclock_count();
+	env_run(e);
+}
+
+/* Overview:
+ *   Switch directly to the runnable env 'e', which runs for the rest of the time slice of
+ *   'curenv', bypassing the scheduling policy. 'curenv' gives up the CPU voluntarily: if still
+ *   runnable, it goes to the tail of its run queue.
+ *
+ * Pre-Condition:
+ *   'e->env_status' is 'ENV_RUNNABLE'.
+ *
+ * Hint:
+ *   'e' is moved to the head of its run queue, so that the policy keeps running it at the next
+ *   tick if the slice is not used up yet.
+ */
+void sched_switch_to(struct Env *e) {
+	struct Env *prev = curenv;
+
+	assert(e->env_status == ENV_RUNNABLE);
+	kclock_update();
+	if (prev != NULL && prev != e) {
+		prev->env_ipc_handoff = 0;
+		prev->env_nvcsw++;
+#if MOS_SCHED_POLICY == SCHED_STRIDE
+		sched_stride_charge();
+#endif
+#if MOS_SCHED_POLICY != SCHED_RR
+		sched_adapt(prev, 1, 0);
+#endif
+		if (prev->env_status == ENV_RUNNABLE) {
+			sched_remove(prev);
+			sched_insert(prev, 0);
+		}
+	}
+	sched_remove(e);
+	sched_insert(e, 1);
+#if MOS_SCHED_POLICY != SCHED_RR
+	// 'e' runs until the end of the slice of 'prev'.
+	kclock_arm_slice(sched_polling);
+#endif
+	sched_stamp = kclock_count();
 	env_run(e);
 }
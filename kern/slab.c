@@ -0,0 +1,158 @@
+#include <error.h>
+#include <pmap.h>
+#include <slab.h>
+
+// Objects start this far into a slab, and are aligned on 'SLAB_ALIGN' bytes.
+#define SLAB_ALIGN 8
+#define SLAB_HDR ROUND(sizeof(struct Slab), SLAB_ALIGN)
+
+// The caches behind 'kmalloc', one per power of two from 16 to 'KMALLOC_MAX' bytes.
+static struct Kmem_cache kmalloc_caches[] = {
+    KMEM_CACHE("kmalloc-16", 16, NULL),
+    KMEM_CACHE("kmalloc-32", 32, NULL),
+    KMEM_CACHE("kmalloc-64", 64, NULL),
+    KMEM_CACHE("kmalloc-128", 128, NULL),
+    KMEM_CACHE("kmalloc-256", 256, NULL),
+    KMEM_CACHE("kmalloc-512", 512, NULL),
+    KMEM_CACHE("kmalloc-1024", 1024, NULL),
+    KMEM_CACHE("kmalloc-2048", KMALLOC_MAX, NULL),
+};
+
+static inline void **slab_link(struct Kmem_cache *c, void *obj) {
+	return (void **)((u_char *)obj + c->kc_link);
+}
+
+/* Overview:
+ *   Lay out the objects of 'c' on its first use: the link word of a free object overlaps the
+ *   object unless 'c' has a constructor.
+ */
+static void cache_layout(struct Kmem_cache *c) {
+	u_int end;
+
+	c->kc_link = c->kc_ctor != NULL ? ROUND(c->kc_size, sizeof(void *)) : 0;
+	end = c->kc_link + sizeof(void *);
+	c->kc_stride = ROUND(end > c->kc_size ? end : c->kc_size, SLAB_ALIGN);
+	if (SLAB_HDR + c->kc_stride > PAGE_SIZE) {
+		panic("kmem cache %s: objects of %u bytes do not fit in a slab", c->kc_name,
+		      c->kc_size);
+	}
+}
+
+/* Overview:
+ *   Add a slab of free (constructed) objects to 'c'.
+ *
+ * Post-Condition:
+ *   Return the new slab, or NULL if there is no free page.
+ */
+static struct Slab *slab_grow(struct Kmem_cache *c) {
+	struct Page *pp;
+	struct Slab *s;
+	u_char *obj, *end;
+
+	if (c->kc_stride == 0) {
+		cache_layout(c);
+	}
+	if (page_alloc_nozero(&pp) != 0) {
+		return NULL;
+	}
+	pp->pp_ref++;
+	s = (struct Slab *)page2kva(pp);
+	s->s_cache = c;
+	s->s_inuse = 0;
+	s->s_free = NULL;
+	// Chain the objects from the last one, so that they are handed out in address order.
+	end = (u_char *)s + SLAB_HDR + (PAGE_SIZE - SLAB_HDR) / c->kc_stride * c->kc_stride;
+	for (obj = end - c->kc_stride; obj >= (u_char *)s + SLAB_HDR; obj -= c->kc_stride) {
+		if (c->kc_ctor != NULL) {
+			c->kc_ctor(obj);
+		}
+		*slab_link(c, obj) = s->s_free;
+		s->s_free = obj;
+	}
+	LIST_INSERT_HEAD(&c->kc_partial, s, s_link);
+	c->kc_nempty++;
+	return s;
+}
+
+/* Overview:
+ *   Allocate an object from cache 'c'.
+ *
+ * Post-Condition:
+ *   Return the object, which is in its constructed state if 'c' has a constructor, or NULL if
+ *   'c' is out of objects and there is no free page to grow it.
+ */
+void *kmem_cache_alloc(struct Kmem_cache *c) {
+	struct Slab *s;
+	void *obj;
+
+	if ((s = LIST_FIRST(&c->kc_partial)) == NULL && (s = slab_grow(c)) == NULL) {
+		return NULL;
+	}
+	obj = s->s_free;
+	s->s_free = *slab_link(c, obj);
+	if (s->s_inuse++ == 0) {
+		c->kc_nempty--;
+	}
+	if (s->s_free == NULL) {
+		LIST_REMOVE(s, s_link);
+		LIST_INSERT_HEAD(&c->kc_full, s, s_link);
+	}
+	return obj;
+}
+
+/* Overview:
+ *   Free the object 'obj' allocated from cache 'c'.
+ *
+ * Pre-Condition:
+ *   If 'c' has a constructor, 'obj' is in its constructed state.
+ *
+ * Hint:
+ *   A slab left without allocated objects is kept for the next allocations, unless 'c' already
+ *   has one: then its page is freed.
+ */
+void kmem_cache_free(struct Kmem_cache *c, void *obj) {
+	struct Slab *s = (struct Slab *)ROUNDDOWN(obj, PAGE_SIZE);
+
+	assert(s->s_cache == c && s->s_inuse > 0);
+	if (s->s_free == NULL) {
+		LIST_REMOVE(s, s_link);
+		LIST_INSERT_HEAD(&c->kc_partial, s, s_link);
+	}
+	*slab_link(c, obj) = s->s_free;
+	s->s_free = obj;
+	if (--s->s_inuse == 0) {
+		if (c->kc_nempty > 0) {
+			LIST_REMOVE(s, s_link);
+			page_decref(pa2page(PADDR(s)));
+		} else {
+			c->kc_nempty++;
+		}
+	}
+}
+
+/* Overview:
+ *   Allocate 'size' bytes, from the smallest of 'kmalloc_caches' large enough.
+ *
+ * Post-Condition:
+ *   Return the (uninitialized) memory, or NULL if 'size' is larger than 'KMALLOC_MAX' or there is
+ *   no free memory.
+ */
+void *kmalloc(u_int size) {
+	struct Kmem_cache *c;
+
+	for (c = kmalloc_caches; c->kc_size < size; c++) {
+		if (c->kc_size == KMALLOC_MAX) {
+			return NULL;
+		}
+	}
+	return kmem_cache_alloc(c);
+}
+
+/* Overview:
+ *   Free the memory at 'obj' allocated by 'kmalloc'. 'obj' may be NULL.
+ */
+void kfree(void *obj) {
+	if (obj != NULL) {
+		kmem_cache_free(((struct Slab *)ROUNDDOWN(obj, PAGE_SIZE))->s_cache, obj);
+	}
+}
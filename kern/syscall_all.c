@@ -1,5 +1,7 @@
+#include <chan.h>
 #include <env.h>
 #include <io.h>
+#include <kclock.h>
 #include <mmu.h>
 #include <pmap.h>
 #include <printk.h>
@@ -117,12 +119,33 @@ static inline int is_illegal_va_range(u_long va, u_int len) {
 	return va + len < va || va < UTEMP || va + len > UTOP;
 }
 
+/* Overview:
+ *   Allocate a large page and map it at 'va' with 'perm' in the address space of 'env' (see
+ *   'sys_mem_alloc').
+ */
+static int mem_alloc_large(struct Env *env, u_int va, u_int perm) {
+	struct Page *pp;
+	int r;
+
+	if (va % LARGE_PAGE_SIZE != 0 || is_illegal_va_range(va, LARGE_PAGE_SIZE)) {
+		return -E_INVAL;
+	}
+	try(page_alloc_order(&pp, LARGE_PAGE_ORDER));
+	if ((r = page_insert_large(env->env_pgdir, env->env_asid, pp, va, perm)) != 0) {
+		page_free_order(pp, LARGE_PAGE_ORDER);
+	}
+	return r;
+}
+
 /* Overview:
  *   Allocate a physical page and map 'va' to it with 'perm' in the address space of 'envid'.
  *   If 'va' is already mapped, that original page is sliently unmapped.
  *   'envid2env' should be used with 'checkperm' set, like in most syscalls, to ensure the target is
  * either the caller or its child.
  *
+ *   With 'PTE_LARGE' in 'perm', a large page of 'LARGE_PAGE_SIZE' bytes is allocated and mapped
+ *   at 'va' instead, which has to be aligned on its size.
+ *
  * Post-Condition:
  *   Return 0 on success.
  *   Return -E_BAD_ENV: 'checkperm' of 'envid2env' fails for 'envid'.
@@ -142,6 +165,10 @@ int sys_mem_alloc(u_int envid, u_int va, u_int perm) {
 	if (is_illegal_va(va)) {
 		return -E_INVAL;
 	}
+	if (perm & PTE_LARGE) {
+		try(envid2env(envid, &env, 1));
+		return mem_alloc_large(env, va, perm);
+	}
 	/* Step 2: Convert the envid to its corresponding 'struct Env *' using 'envid2env'. */
 	/* Hint: **Always** validate the permission in syscalls! */
 	/* Exercise 4.4: Your code here. (2/3) */
@@ -220,6 +247,82 @@ int sys_mem_unmap(u_int envid, u_int va) {
 	return 0;
 }
 
+/* Overview:
+ *   Check that the 'npages' pages from 'va' on are legal user memory, with 'va' aligned on a page.
+ */
+static inline int is_illegal_page_range(u_long va, u_int npages) {
+	return va % PAGE_SIZE != 0 || npages > VPN(UTOP) ||
+	       is_illegal_va_range(va, npages * PAGE_SIZE);
+}
+
+/* Overview:
+ *   Allocate 'npages' pages and map them from 'va' on in the address space of 'envid' with 'perm',
+ *   as 'sys_mem_alloc' does for one page.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_BAD_ENV: 'checkperm' of 'envid2env' fails for 'envid'.
+ *   Return -E_INVAL:   the range is illegal (see 'is_illegal_page_range').
+ *   Return -E_NO_MEM:  out of memory. The pages allocated until then stay mapped.
+ */
+int sys_mem_alloc_range(u_int envid, u_int va, u_int npages, u_int perm) {
+	struct Env *env;
+
+	if (is_illegal_page_range(va, npages)) {
+		return -E_INVAL;
+	}
+	try(envid2env(envid, &env, 1));
+	return page_alloc_range(env->env_pgdir, env->env_asid, va, npages, perm);
+}
+
+/* Overview:
+ *   Map the pages mapped in the caller's 'npages' pages from 'srcva' on at the same offsets from
+ *   'dstva' on in the address space of 'dstid', as 'sys_mem_map' does for one page, each with its
+ *   own permission. Unmapped pages are skipped. 'flags' are those of 'page_map_range':
+ *   'MAP_COW' maps the private writable pages copy-on-write in both envs (as 'fork' does), and
+ *   'MAP_LIBRARY' maps only the pages shared with 'PTE_LIBRARY' (as 'spawn' does).
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_BAD_ENV: 'checkperm' of 'envid2env' fails for 'dstid'.
+ *   Return -E_INVAL:   a range is illegal, or the ranges overlap in the caller.
+ *   Return -E_NO_MEM:  a page table couldn't be allocated. The pages mapped until then stay mapped.
+ */
+int sys_mem_map_range(u_int dstid, u_int srcva, u_int dstva, u_int npages, u_int flags) {
+	struct Env *dstenv;
+
+	if (is_illegal_page_range(srcva, npages) || is_illegal_page_range(dstva, npages)) {
+		return -E_INVAL;
+	}
+	try(envid2env(dstid, &dstenv, 1));
+	if (dstenv == curenv && srcva != dstva && srcva < dstva + npages * PAGE_SIZE &&
+	    dstva < srcva + npages * PAGE_SIZE) {
+		return -E_INVAL;
+	}
+	return page_map_range(curenv->env_pgdir, curenv->env_asid, srcva, dstenv->env_pgdir,
+			      dstenv->env_asid, dstva, npages, flags);
+}
+
+/* Overview:
+ *   Unmap the 'npages' pages from 'va' on in the address space of 'envid', as 'sys_mem_unmap'
+ *   does for one page.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_BAD_ENV: 'checkperm' of 'envid2env' fails for 'envid'.
+ *   Return -E_INVAL:   the range is illegal.
+ */
+int sys_mem_unmap_range(u_int envid, u_int va, u_int npages) {
+	struct Env *e;
+
+	if (is_illegal_page_range(va, npages)) {
+		return -E_INVAL;
+	}
+	try(envid2env(envid, &e, 1));
+	page_remove_range(e->env_pgdir, e->env_asid, va, npages);
+	return 0;
+}
+
 /* Overview:
  *   Allocate a new env as a child of 'curenv'.
  *
@@ -256,6 +359,37 @@ int sys_exofork(void) {
 	return e->env_id;
 }
 
+/* Overview:
+ *   Create a child of 'curenv' with a copy of its address space below 'USTACKTOP', and make it
+ *   runnable, as the user-level 'fork' does with 'sys_exofork' and the syscalls after it.
+ *
+ * Post-Condition:
+ *   Return the child's envid on success, and 0 in the child, which:
+ *   - starts from the context saved below 'KSTACKTOP', like with 'sys_exofork'.
+ *   - maps the same pages as 'curenv' with 'MAP_COW' (see 'page_map_range'): private writable
+ *     pages are copy-on-write in both envs, pages with 'PTE_PRIVATE' are left out.
+ *   - has the same TLB Mod user exception entry as 'curenv'.
+ *   Return the original error if underlying calls fail. No child is left then.
+ */
+int sys_fork(void) {
+	struct Env *e;
+	int r;
+
+	if ((r = sys_exofork()) < 0) {
+		return r;
+	}
+	try(envid2env(r, &e, 0));
+	if ((r = page_map_range(curenv->env_pgdir, curenv->env_asid, UTEMP, e->env_pgdir,
+				e->env_asid, UTEMP, VPN(USTACKTOP - UTEMP), MAP_COW)) != 0) {
+		env_destroy(e);
+		return r;
+	}
+	e->env_user_tlb_mod_entry = curenv->env_user_tlb_mod_entry;
+	e->env_status = ENV_RUNNABLE;
+	sched_insert(e, 0);
+	return e->env_id;
+}
+
 /* Overview:
  *   Set 'envid''s 'env_status' to 'status' and update 'env_sched_list'.
  *
@@ -282,9 +416,9 @@ int sys_set_env_status(u_int envid, u_int status) {
 	/* Step 3: Update 'env_sched_list' if the 'env_status' of 'env' is being changed. */
 	/* Exercise 4.14: Your code here. (3/3) */
 	if (status == ENV_RUNNABLE && env->env_status != ENV_RUNNABLE) {
-		TAILQ_INSERT_TAIL(&env_sched_list, env, env_sched_link);
+		sched_insert(env, 0);
 	} else if (status == ENV_NOT_RUNNABLE && env->env_status != ENV_NOT_RUNNABLE) {
-		TAILQ_REMOVE(&env_sched_list, env, env_sched_link);
+		sched_remove(env);
 	}
 	
 	/* Step 4: Set the 'env_status' of 'env'. */
@@ -297,6 +431,30 @@ int sys_set_env_status(u_int envid, u_int status) {
 	return 0;
 }
 
+/* Overview:
+ *   Set the scheduling weight ('env_pri') of 'envid' to 'weight'. Under SCHED_STRIDE it is the
+ *   share of CPU time, otherwise the number of ticks per time slice. Children created by 'fork' or
+ *   'spawn' inherit the weight of their parent.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_BAD_ENV: 'envid' is not a child of 'curenv' (an env may not raise its own weight).
+ *   Return -E_INVAL: 'weight' is not within [1, SCHED_MAX_WEIGHT].
+ */
+int sys_set_sched_param(u_int envid, u_int weight) {
+	struct Env *e;
+
+	if (weight < 1 || weight > SCHED_MAX_WEIGHT) {
+		return -E_INVAL;
+	}
+	try(envid2env(envid, &e, 1));
+	if (e->env_parent_id != curenv->env_id) {
+		return -E_BAD_ENV;
+	}
+	e->env_pri = weight;
+	return 0;
+}
+
 /* Overview:
  *  Set envid's trap frame to 'tf'.
  *
@@ -335,18 +493,216 @@ void sys_panic(char *msg) {
 }
 
 /* Overview:
- *   Wait for a message (a value, together with a page if 'dstva' is not 0) from other envs.
- *   'curenv' is blocked until a message is sent.
+ *   Return non-zero if 'e' is receiving and accepts a message from 'from': either 'e' receives
+ *   from any env, or it waits for the reply of 'from' to its 'sys_ipc_call'.
+ */
+static inline int ipc_accepts(struct Env *e, struct Env *from) {
+	return e->env_ipc_recving &&
+	       (e->env_ipc_recv_from == 0 || e->env_ipc_recv_from == from->env_id);
+}
+
+/* Overview:
+ *   Copy the message words at 'msgva' in 'curenv' into 'msg'. If 'msgva' is 0, 'msg' is empty.
  *
  * Post-Condition:
  *   Return 0 on success.
- *   Return -E_INVAL: 'dstva' is neither 0 nor a legal address.
+ *   Return -E_INVAL: 'msgva' is neither 0 nor a legal address, or the message has more than
+ *   'IPC_MSG_WORDS' words.
  */
-int sys_ipc_recv(u_int dstva) {
-	/* Step 1: Check if 'dstva' is either zero or a legal address. */
-	if (dstva != 0 && is_illegal_va(dstva)) {
+static int ipc_copy_msg(struct Ipc_msg *msg, u_int msgva) {
+	const struct Ipc_msg *umsg = (const struct Ipc_msg *)msgva;
+
+	if (msgva == 0) {
+		msg->len = 0;
+		return 0;
+	}
+	if (is_illegal_va_range(msgva, sizeof(struct Ipc_msg))) {
 		return -E_INVAL;
 	}
+	msg->len = umsg->len;
+	if (msg->len > IPC_MSG_WORDS) {
+		return -E_INVAL;
+	}
+	memcpy(msg->words, umsg->words, msg->len * sizeof(u_int));
+	return 0;
+}
+
+/* Overview:
+ *   Fill 'iov' with the single page (if 'srcva' is not 0) sent by 'sys_ipc_try_send' and the
+ *   like, mapped at the start of the receive window.
+ *
+ * Post-Condition:
+ *   Return the number of entries used in 'iov' (always 1: an entry with 'srcva' 0 sends no
+ *   page, but still sets 'env_ipc_perm' of the receiver).
+ */
+static u_int ipc_one_page(struct Ipc_page *iov, u_int srcva, u_int perm) {
+	iov->srcva = srcva;
+	iov->dstoff = 0;
+	iov->perm = perm;
+	return 1;
+}
+
+/* Overview:
+ *   Copy the 'npages' page entries at 'iovva' in 'curenv' into 'iov' (see 'sys_ipc_sendv').
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_INVAL: 'npages' is 0 or above 'IPC_MAX_PAGES', the entries are not in legal
+ *   memory, or some 'srcva' is neither 0 nor a legal address.
+ */
+static int ipc_copy_pages(struct Ipc_page *iov, u_int iovva, u_int npages) {
+	u_int i;
+
+	if (npages == 0 || npages > IPC_MAX_PAGES ||
+	    is_illegal_va_range(iovva, npages * sizeof(struct Ipc_page))) {
+		return -E_INVAL;
+	}
+	memcpy(iov, (const void *)iovva, npages * sizeof(struct Ipc_page));
+	for (i = 0; i < npages; i++) {
+		if (iov[i].srcva != 0 && is_illegal_va(iov[i].srcva)) {
+			return -E_INVAL;
+		}
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Deliver a message from 'from' to 'e', which is receiving: a 'value' and the words in 'msg'
+ *   (none if 'msg' is NULL), together with the 'npages' pages described in 'iov', which are
+ *   mapped in the receive window of 'e' all at once.
+ *
+ * Post-Condition:
+ *   Return 0 on success, and the target env is updated as follows:
+ *   - 'env_ipc_recving' is set to 0 to block future sends.
+ *   - 'env_ipc_from' is set to the sender's envid.
+ *   - 'env_ipc_value' is set to the 'value'.
+ *   - 'env_ipc_msg' is set to the words in 'msg'.
+ *   - each page with a non-zero 'srcva' is mapped at 'env_ipc_dstva + dstoff' in 'e', to the
+ *     same page as 'srcva' in 'from', with its 'perm'; 'env_ipc_npages' is the number of pages
+ *     mapped, and 'env_ipc_perm' is 'PTE_V' with the 'perm' of the first entry.
+ *   - each page with 'PTE_DONATE' in its 'perm' is unmapped from 'from': it is moved rather than
+ *     shared.
+ *   Return -E_INVAL if some 'srcva' is not mapped in 'from', or some 'dstoff' is not page-aligned
+ *   or falls out of the receive window, leaving 'e' receiving.
+ *   Return the original error when underlying calls fail. No page is mapped on error (but the
+ *   pages previously mapped in the window may be gone).
+ *
+ * Hint:
+ *   Waking 'e' up is left to the caller.
+ */
+static int ipc_deliver(struct Env *e, struct Env *from, u_int value, const struct Ipc_page *iov,
+		       u_int npages, const struct Ipc_msg *msg) {
+	struct Page *p[IPC_MAX_PAGES];
+	u_int i, n;
+	int r;
+
+	// Check all the pages first, so that the message is delivered either whole or not at all.
+	for (i = 0; i < npages; i++) {
+		if (iov[i].srcva == 0) {
+			continue;
+		}
+		if ((iov[i].dstoff & (PAGE_SIZE - 1)) != 0 ||
+		    iov[i].dstoff / PAGE_SIZE >= e->env_ipc_dstpages) {
+			return -E_INVAL;
+		}
+		if ((p[i] = page_lookup(from->env_pgdir, iov[i].srcva, NULL)) == NULL) {
+			return -E_INVAL;
+		}
+	}
+	for (i = n = 0; i < npages; i++) {
+		if (iov[i].srcva == 0) {
+			continue;
+		}
+		r = page_insert(e->env_pgdir, e->env_asid, p[i], e->env_ipc_dstva + iov[i].dstoff,
+				iov[i].perm & ~PTE_DONATE);
+		if (r != 0) {
+			while (i-- > 0) {
+				if (iov[i].srcva != 0) {
+					page_remove(e->env_pgdir, e->env_asid,
+						    e->env_ipc_dstva + iov[i].dstoff);
+				}
+			}
+			return r;
+		}
+		n++;
+	}
+	// The receiver now holds a reference to the donated pages, so the sender can let go of them.
+	for (i = 0; i < npages; i++) {
+		if (iov[i].srcva != 0 && (iov[i].perm & PTE_DONATE) &&
+		    (from != e || iov[i].srcva != e->env_ipc_dstva + iov[i].dstoff)) {
+			page_remove(from->env_pgdir, from->env_asid, iov[i].srcva);
+		}
+	}
+	e->env_ipc_value = value;
+	e->env_ipc_msg.len = 0;
+	if (msg != NULL) {
+		e->env_ipc_msg.len = msg->len;
+		memcpy(e->env_ipc_msg.words, msg->words, msg->len * sizeof(u_int));
+	}
+	e->env_ipc_from = from->env_id;
+	e->env_ipc_perm = PTE_V | (npages != 0 ? iov[0].perm : 0);
+	e->env_ipc_npages = n;
+	e->env_ipc_recving = 0;
+	return 0;
+}
+
+/* Overview:
+ *   Start receiving into the window of 'dstpages' pages at 'dstva', from 'from' only if it is not
+ *   NULL, and take the message of the first sender blocked in 'sys_ipc_send' or 'sys_ipc_call' on
+ *   'curenv' that we accept, if any.
+ *
+ *   Each sender taken off the queue is woken up with the result of its send, except a caller
+ *   whose request is received: it goes on waiting for our reply (see 'sys_ipc_call').
+ *
+ * Post-Condition:
+ *   Return 0 if a message was received. Otherwise return -E_IPC_NOT_RECV, leaving 'curenv' not
+ *   receiving yet.
+ */
+static int ipc_recv_queued(u_int dstva, u_int dstpages, struct Env *from) {
+	struct Env *s, *next;
+	int r;
+
+	curenv->env_ipc_dstva = dstva;
+	curenv->env_ipc_dstpages = dstpages;
+	curenv->env_ipc_recv_from = from != NULL ? from->env_id : 0;
+	curenv->env_ipc_recving = 1;
+	for (s = TAILQ_FIRST(&curenv->env_ipc_senders); s != NULL; s = next) {
+		next = TAILQ_NEXT(s, env_wait_link);
+		if (!ipc_accepts(curenv, s)) {
+			continue;
+		}
+		r = ipc_deliver(curenv, s, s->env_ipc_out_value, s->env_ipc_out_pages,
+				s->env_ipc_out_npages, &s->env_ipc_out_msg);
+		if (r == 0 && s->env_ipc_calling) {
+			s->env_ipc_calling = 0;
+			s->env_ipc_recving = 1;
+			s->env_ipc_recv_from = curenv->env_id;
+			sched_wait_move(s, &curenv->env_ipc_callers);
+		} else {
+			sched_wakeup(s, r);
+		}
+		if (r == 0) {
+			return 0;
+		}
+	}
+	curenv->env_ipc_recving = 0;
+	return -E_IPC_NOT_RECV;
+}
+
+/* Overview:
+ *   Wait for a message into the window of 'dstpages' pages at 'dstva', from 'from' only if it is
+ *   not NULL. If a blocked sender is accepted, its message is received at once. Otherwise
+ *   'curenv' is blocked until a message is sent.
+ *
+ * Pre-Condition:
+ *   'dstva' is either zero or a legal address, and so is the whole window if 'dstpages' > 1.
+ */
+static int ipc_wait(u_int dstva, u_int dstpages, struct Env *from) {
+	struct Env *e;
+
+	if (ipc_recv_queued(dstva, dstpages, from) == 0) {
+		return 0;
+	}
 
 	/* Step 2: Set 'curenv->env_ipc_recving' to 1. */
 	/* Exercise 4.8: Your code here. (1/8) */
@@ -355,15 +711,110 @@ int sys_ipc_recv(u_int dstva) {
 	/* Exercise 4.8: Your code here. (2/8) */
 	curenv->env_ipc_dstva = dstva;
 	/* Step 4: Set the status of 'curenv' to 'ENV_NOT_RUNNABLE' and remove it from
-	 * 'env_sched_list'. */
+	 * 'env_sched_list'. A closed receive waits on the 'env_ipc_callers' list of 'from', so that
+	 * it fails if 'from' is destroyed. */
 	/* Exercise 4.8: Your code here. (3/8) */
-	curenv->env_status = ENV_NOT_RUNNABLE;
-	TAILQ_REMOVE(&env_sched_list, curenv, env_sched_link);
+	sched_block(from != NULL ? &from->env_ipc_callers : NULL);
 	/* Step 5: Give up the CPU and block until a message is received. */
 	((struct Trapframe *)KSTACKTOP - 1)->regs[2] = 0;
+	/* If we have just woken up a receiver (typically to send it a request, which we now wait for
+	 * a reply to), hand the rest of our time slice over to it. */
+	if (curenv->env_ipc_handoff != 0 && envid2env(curenv->env_ipc_handoff, &e, 0) == 0 &&
+	    e->env_status == ENV_RUNNABLE) {
+		sched_switch_to(e);
+	}
 	schedule(1);
 }
 
+/* Overview:
+ *   Wait for a message (a value, together with a page if 'dstva' is not 0) from other envs.
+ *   If some senders are blocked in 'sys_ipc_send' on 'curenv', the message of the first one is
+ *   received at once. Otherwise 'curenv' is blocked until a message is sent.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_INVAL: 'dstva' is neither 0 nor a legal address.
+ */
+int sys_ipc_recv(u_int dstva) {
+	/* Step 1: Check if 'dstva' is either zero or a legal address. */
+	if (dstva != 0 && is_illegal_va(dstva)) {
+		return -E_INVAL;
+	}
+	return ipc_wait(dstva, 1, NULL);
+}
+
+/* Overview:
+ *   Like 'sys_ipc_recv', but receive into a window of 'dstpages' pages at 'dstva', in which a
+ *   sender using 'sys_ipc_sendv' may map up to 'dstpages' pages with a single message. The number
+ *   of pages received is in 'env_ipc_npages'.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_INVAL: 'dstpages' is 0 or above 'IPC_MAX_PAGES', or the window is not legal memory.
+ */
+int sys_ipc_recvv(u_int dstva, u_int dstpages) {
+	if (dstpages == 0 || dstpages > IPC_MAX_PAGES ||
+	    is_illegal_va_range(dstva, dstpages * PAGE_SIZE)) {
+		return -E_INVAL;
+	}
+	return ipc_wait(dstva, dstpages, NULL);
+}
+
+/* Overview:
+ *   Like 'sys_ipc_recv', but give up after 'ticks' timer ticks.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_TIMEOUT: no message arrived in time ('ticks' is 0 means not waiting at all).
+ *   Return -E_INVAL: 'dstva' is neither 0 nor a legal address.
+ */
+int sys_ipc_recv_timed(u_int dstva, u_int ticks) {
+	if (dstva != 0 && is_illegal_va(dstva)) {
+		return -E_INVAL;
+	}
+	if (ipc_recv_queued(dstva, 1, NULL) == 0) {
+		return 0;
+	}
+	if (ticks == 0) {
+		return -E_TIMEOUT;
+	}
+	kclock_arm(curenv, ticks);
+	return ipc_wait(dstva, 1, NULL);
+}
+
+/* Overview:
+ *   Try to send a 'value' and the words in 'msg' (none if 'msg' is NULL), together with the
+ *   'npages' pages described in 'iov', to the target env 'envid'. See 'sys_ipc_try_send'.
+ *
+ * Pre-Condition:
+ *   Each 'srcva' in 'iov' is either zero or a legal address.
+ */
+static int ipc_try_send(u_int envid, u_int value, const struct Ipc_page *iov, u_int npages,
+			const struct Ipc_msg *msg) {
+	struct Env *e;
+
+	/* Step 2: Convert 'envid' to 'struct Env *e'. */
+	/* This is the only syscall where the 'envid2env' should be used with 'checkperm' UNSET,
+	 * because the target env is not restricted to 'curenv''s children. */
+	/* Exercise 4.8: Your code here. (5/8) */
+	try(envid2env(envid, &e, 0));
+	/* Step 3: Check if the target is waiting for a message. */
+	/* Exercise 4.8: Your code here. (6/8) */
+	if (!ipc_accepts(e, curenv)) {
+		return -E_IPC_NOT_RECV;
+	}
+	/* Step 4: Set the target's ipc fields, mapping the pages sent into the window at
+	 * 'e->env_ipc_dstva' in 'e'. */
+	try(ipc_deliver(e, curenv, value, iov, npages, msg));
+
+	/* Step 5: Set the target's status to 'ENV_RUNNABLE' again and insert it to the tail of
+	 * 'env_sched_list'. */
+	/* Exercise 4.8: Your code here. (7/8) */
+	sched_wakeup(e, 0);
+	curenv->env_ipc_handoff = e->env_id;
+	return 0;
+}
+
 /* Overview:
  *   Try to send a 'value' (together with a page if 'srcva' is not 0) to the target env 'envid'.
  *
@@ -374,62 +825,440 @@ int sys_ipc_recv(u_int dstva) {
  *   - 'env_ipc_value' is set to the 'value'.
  *   - 'env_status' is set to 'ENV_RUNNABLE' again to recover from 'ipc_recv'.
  *   - if 'srcva' is not NULL, map 'env_ipc_dstva' to the same page mapped at 'srcva' in 'curenv'
- *     with 'perm'.
+ *     with 'perm'. If 'perm' has 'PTE_DONATE', the page is moved: 'srcva' is unmapped from
+ *     'curenv'.
  *
  *   Return -E_IPC_NOT_RECV if the target has not been waiting for an IPC message with
- *   'sys_ipc_recv'.
+ *   'sys_ipc_recv' (or waits for the reply of another env to its 'sys_ipc_call').
  *   Return the original error when underlying calls fail.
  */
 int sys_ipc_try_send(u_int envid, u_int value, u_int srcva, u_int perm) {
-	struct Env *e;
-	struct Page *p;
+	struct Ipc_page page;
 
 	/* Step 1: Check if 'srcva' is either zero or a legal address. */
 	/* Exercise 4.8: Your code here. (4/8) */
 	if (srcva != 0 && is_illegal_va(srcva)) {
 		return -E_INVAL;
 	}
-	/* Step 2: Convert 'envid' to 'struct Env *e'. */
-	/* This is the only syscall where the 'envid2env' should be used with 'checkperm' UNSET,
-	 * because the target env is not restricted to 'curenv''s children. */
-	/* Exercise 4.8: Your code here. (5/8) */
+	return ipc_try_send(envid, value, &page, ipc_one_page(&page, srcva, perm), NULL);
+}
+
+/* Overview:
+ *   Block 'curenv' on the 'env_ipc_senders' queue of 'e' until 'e' receives its message (the words
+ *   and pages of which are already in 'curenv->env_ipc_out_msg' and 'curenv->env_ipc_out_pages').
+ *   If 'calling' is set, 'curenv' then goes on waiting for the reply of 'e' (see 'sys_ipc_call').
+ */
+static void __attribute__((noreturn))
+ipc_send_block(struct Env *e, u_int value, u_int npages, int calling) {
+	curenv->env_ipc_out_value = value;
+	curenv->env_ipc_out_npages = npages;
+	curenv->env_ipc_calling = calling;
+	sched_block(&e->env_ipc_senders);
+	((struct Trapframe *)KSTACKTOP - 1)->regs[2] = 0;
+	schedule(1);
+}
+
+/* Overview:
+ *   Send a 'value', the message words at 'msgva' and the first 'npages' pages in
+ *   'curenv->env_ipc_out_pages' to 'envid', blocking until it receives them. See 'sys_ipc_send'.
+ */
+static int ipc_send(u_int envid, u_int value, u_int npages, u_int msgva) {
+	struct Env *e;
+	int r;
+
 	try(envid2env(envid, &e, 0));
-	/* Step 3: Check if the target is waiting for a message. */
-	/* Exercise 4.8: Your code here. (6/8) */
-	if (e->env_ipc_recving == 0) {
-		return -E_IPC_NOT_RECV;
+	if (e == curenv) {
+		return -E_INVAL;
 	}
-	/* Step 4: Set the target's ipc fields. */
-	e->env_ipc_value = value;
-	e->env_ipc_from = curenv->env_id;
-	e->env_ipc_perm = PTE_V | perm;
-	e->env_ipc_recving = 0;
+	try(ipc_copy_msg(&curenv->env_ipc_out_msg, msgva));
+	if ((r = ipc_try_send(envid, value, curenv->env_ipc_out_pages, npages,
+			      &curenv->env_ipc_out_msg)) != -E_IPC_NOT_RECV) {
+		return r;
+	}
+	ipc_send_block(e, value, npages, 0);
+}
 
-	/* Step 5: Set the target's status to 'ENV_RUNNABLE' again and insert it to the tail of
-	 * 'env_sched_list'. */
-	/* Exercise 4.8: Your code here. (7/8) */
-	e->env_status = ENV_RUNNABLE;
-	TAILQ_INSERT_TAIL(&env_sched_list, e, env_sched_link);
-	/* Step 6: If 'srcva' is not zero, map the page at 'srcva' in 'curenv' to 'e->env_ipc_dstva'
-	 * in 'e'. */
-	/* Return -E_INVAL if 'srcva' is not zero and not mapped in 'curenv'. */
-	if (srcva != 0) {
-		/* Exercise 4.8: Your code here. (8/8) */
-		p = page_lookup(curenv->env_pgdir, srcva, NULL);
-		if (p == NULL) {
-			return -E_INVAL;
+/* Overview:
+ *   Send a 'value' and the message words at 'msgva' (see 'struct Ipc_msg', none if 'msgva' is 0),
+ *   together with a page if 'srcva' is not 0, to the target env 'envid', blocking until it
+ *   receives it if it is not receiving yet.
+ *
+ *   Blocked senders wait on the 'env_ipc_senders' queue of the target, which serves them in FIFO
+ *   order in 'sys_ipc_recv'.
+ *
+ *   With 'PTE_DONATE' in 'perm', the page is handed over rather than shared: it is unmapped from
+ *   'curenv' when the target receives it, so no 'sys_mem_unmap' is needed afterwards.
+ *
+ * Post-Condition:
+ *   Return 0 once the message is received.
+ *   Return -E_INVAL: 'srcva' is neither 0 nor a legal address, or is not mapped in 'curenv' by
+ *   the time the message is received; or the target is 'curenv'; or the message words are
+ *   invalid (see 'ipc_copy_msg').
+ *   Return -E_BAD_ENV: the target does not exist, or is destroyed before receiving the message.
+ *   Return the original error when underlying calls fail.
+ */
+int sys_ipc_send(u_int envid, u_int value, u_int srcva, u_int perm, u_int msgva) {
+	if (srcva != 0 && is_illegal_va(srcva)) {
+		return -E_INVAL;
+	}
+	return ipc_send(envid, value, ipc_one_page(curenv->env_ipc_out_pages, srcva, perm), msgva);
+}
+
+/* Overview:
+ *   Like 'sys_ipc_send', but send the 'npages' pages described by the 'struct Ipc_page' entries
+ *   at 'iovva' with a single message, each mapped at its 'dstoff' in the receive window of the
+ *   target (see 'sys_ipc_recvv'). Either all the pages are mapped or none is.
+ *
+ * Post-Condition:
+ *   Return 0 once the message is received.
+ *   Return -E_INVAL: as for 'sys_ipc_send', or the entries are invalid (see 'ipc_copy_pages'),
+ *   or some 'dstoff' is not page-aligned or out of the receive window.
+ *   Return -E_BAD_ENV: the target does not exist, or is destroyed before receiving the message.
+ *   Return the original error when underlying calls fail.
+ */
+int sys_ipc_sendv(u_int envid, u_int value, u_int iovva, u_int npages, u_int msgva) {
+	try(ipc_copy_pages(curenv->env_ipc_out_pages, iovva, npages));
+	return ipc_send(envid, value, npages, msgva);
+}
+
+/* Overview:
+ *   Send a request ('value', the message words at 'msgva' and the first 'npages' pages in
+ *   'curenv->env_ipc_out_pages') to 'envid', then wait for its reply into the window of 'dstpages'
+ *   pages at 'dstva'. See 'sys_ipc_call'.
+ *
+ * Pre-Condition:
+ *   The receive window is legal memory, or 'dstva' is 0.
+ */
+static int ipc_call(u_int envid, u_int value, u_int npages, u_int msgva, u_int dstva,
+		    u_int dstpages) {
+	struct Env *e;
+	int r;
+
+	try(envid2env(envid, &e, 0));
+	if (e == curenv) {
+		return -E_INVAL;
+	}
+	try(ipc_copy_msg(&curenv->env_ipc_out_msg, msgva));
+	if ((r = ipc_try_send(envid, value, curenv->env_ipc_out_pages, npages,
+			      &curenv->env_ipc_out_msg)) != -E_IPC_NOT_RECV) {
+		if (r != 0) {
+			return r;
 		}
-		try(page_insert(e->env_pgdir, e->env_asid, p, e->env_ipc_dstva, perm));
+		return ipc_wait(dstva, dstpages, e);
+	}
+	curenv->env_ipc_dstva = dstva;
+	curenv->env_ipc_dstpages = dstpages;
+	ipc_send_block(e, value, npages, 1);
+}
+
+/* Overview:
+ *   Send a request to 'envid' (with the message words at 'msgva') as 'sys_ipc_send' does, then
+ *   wait for its reply (a message from 'envid' only, received into 'dstva') as 'sys_ipc_recv'
+ *   does, in a single syscall.
+ *
+ *   If 'envid' is receiving, the CPU is switched to it directly. Otherwise the request waits in
+ *   its queue of senders, and 'curenv' goes on waiting for the reply once it is received. Other
+ *   messages sent to 'curenv' meanwhile stay queued.
+ *
+ * Post-Condition:
+ *   Return 0 once the reply is received (in 'env_ipc_value', 'env_ipc_from', 'env_ipc_perm').
+ *   Return -E_INVAL: 'srcva' or 'dstva' is neither 0 nor a legal address, or the target is
+ *   'curenv'.
+ *   Return -E_BAD_ENV: the target does not exist, or is destroyed before replying.
+ *   Return the original error when underlying calls fail.
+ */
+int sys_ipc_call(u_int envid, u_int value, u_int srcva, u_int perm, u_int dstva, u_int msgva) {
+	if ((srcva != 0 && is_illegal_va(srcva)) || (dstva != 0 && is_illegal_va(dstva))) {
+		return -E_INVAL;
+	}
+	return ipc_call(envid, value, ipc_one_page(curenv->env_ipc_out_pages, srcva, perm), msgva,
+			dstva, 1);
+}
+
+/* Overview:
+ *   Like 'sys_ipc_call' with a request of message words only, but receive the reply into a window
+ *   of 'dstpages' pages at 'dstva', so that the reply may carry several pages (see
+ *   'sys_ipc_replyv_wait'). The number of pages received is in 'env_ipc_npages'.
+ *
+ * Post-Condition:
+ *   As for 'sys_ipc_call'. Return -E_INVAL also if 'dstpages' is 0 or above 'IPC_MAX_PAGES', or
+ *   the window is not legal memory.
+ */
+int sys_ipc_callv(u_int envid, u_int value, u_int msgva, u_int dstva, u_int dstpages) {
+	if (dstpages == 0 || dstpages > IPC_MAX_PAGES ||
+	    is_illegal_va_range(dstva, dstpages * PAGE_SIZE)) {
+		return -E_INVAL;
+	}
+	return ipc_call(envid, value, 0, msgva, dstva, dstpages);
+}
+
+/* Overview:
+ *   Reply to 'envid' (unless it is 0) with a 'value', the message words at 'msgva' and the first
+ *   'npages' pages in 'curenv->env_ipc_out_pages', without blocking, then wait for the next
+ *   message into 'dstva'. See 'sys_ipc_reply_wait'.
+ *
+ * Pre-Condition:
+ *   'dstva' is either zero or a legal address.
+ */
+static int ipc_reply_wait(u_int envid, u_int value, u_int npages, u_int msgva, u_int dstva) {
+	if (envid != 0) {
+		try(ipc_copy_msg(&curenv->env_ipc_out_msg, msgva));
+		ipc_try_send(envid, value, curenv->env_ipc_out_pages, npages,
+			     &curenv->env_ipc_out_msg);
+	}
+	return ipc_wait(dstva, 1, NULL);
+}
+
+/* Overview:
+ *   Reply to the 'sys_ipc_call' of 'envid' (unless 'envid' is 0) with a 'value' and the message
+ *   words at 'msgva' (together with a page if 'srcva' is not 0), then wait for the next message
+ *   as 'sys_ipc_recv' does, in a single syscall. The CPU is switched to the caller directly if no
+ *   other message is pending.
+ *
+ * Post-Condition:
+ *   Return 0 once the next message is received.
+ *   Return -E_INVAL: 'dstva' is neither 0 nor a legal address, or the message words are invalid
+ *   (see 'ipc_copy_msg').
+ *
+ * Hint:
+ *   Like an L4 reply, the reply never blocks: it is dropped if the caller is not waiting for it
+ *   (e.g. it has been destroyed). A server must not be held up by its clients.
+ */
+int sys_ipc_reply_wait(u_int envid, u_int value, u_int srcva, u_int perm, u_int dstva,
+		       u_int msgva) {
+	if ((srcva != 0 && is_illegal_va(srcva)) || (dstva != 0 && is_illegal_va(dstva))) {
+		return -E_INVAL;
+	}
+	return ipc_reply_wait(envid, value, ipc_one_page(curenv->env_ipc_out_pages, srcva, perm),
+			      msgva, dstva);
+}
+
+/* Overview:
+ *   Like 'sys_ipc_reply_wait', but reply with the 'npages' pages described by the entries at
+ *   'iovva' (see 'sys_ipc_sendv') and no message words. The caller receives them in the window
+ *   of its 'sys_ipc_callv'.
+ *
+ * Post-Condition:
+ *   As for 'sys_ipc_reply_wait'. Return -E_INVAL also if the entries are invalid (see
+ *   'ipc_copy_pages'); a reply with pages out of the window of the caller is dropped.
+ */
+int sys_ipc_replyv_wait(u_int envid, u_int value, u_int iovva, u_int npages, u_int dstva) {
+	if (dstva != 0 && is_illegal_va(dstva)) {
+		return -E_INVAL;
+	}
+	if (envid != 0) {
+		try(ipc_copy_pages(curenv->env_ipc_out_pages, iovva, npages));
+	}
+	return ipc_reply_wait(envid, value, npages, 0, dstva);
+}
+
+/* Overview:
+ *   Post the notification 'bits' to 'e', waking it up if it waits for one of them.
+ */
+static void notify_post(struct Env *e, u_int bits) {
+	u_int got;
+
+	e->env_notify_bits |= bits;
+	if ((got = e->env_notify_bits & e->env_notify_mask) != 0) {
+		e->env_notify_bits &= ~got;
+		e->env_notify_mask = 0;
+		sched_wakeup(e, got);
+	}
+}
+
+/* Overview:
+ *   Post the notification 'bits' to 'envid', without blocking. Bits posted to an env stay set
+ *   until it takes them with 'sys_notify_wait', so a notification cannot be lost, but the same
+ *   bit posted twice is only taken once.
+ *
+ *   Any env may post the bits in 'NOTIFY_ANY', which only cost the target a wake-up. Other bits
+ *   may only be posted to 'curenv' or its children, as checked by 'envid2env'.
+ *
+ * Post-Condition:
+ *   Return 0 on success, waking 'envid' up if it waits for one of the 'bits'.
+ *   Return -E_BAD_ENV: 'envid' does not exist, or 'bits' are not all in 'NOTIFY_ANY' and
+ *   'envid' is neither 'curenv' nor its child.
+ */
+int sys_notify(u_int envid, u_int bits) {
+	struct Env *e;
+
+	try(envid2env(envid, &e, (bits & ~NOTIFY_ANY) != 0));
+	notify_post(e, bits);
+	return 0;
+}
+
+/* Overview:
+ *   Take the notification bits of 'curenv' in 'mask', blocking until one of them is posted, or
+ *   until 'ticks' timer ticks have passed if 'ticks' is not 0.
+ *
+ * Post-Condition:
+ *   Return the bits in 'mask' taken (cleared), or 0 if none was posted in time (or 'mask' is 0).
+ */
+u_int sys_notify_wait(u_int mask, u_int ticks) {
+	u_int got = curenv->env_notify_bits & mask;
+
+	if (got != 0 || mask == 0) {
+		curenv->env_notify_bits &= ~got;
+		return got;
+	}
+	if (ticks != 0) {
+		kclock_arm(curenv, ticks);
+	}
+	curenv->env_notify_mask = mask;
+	sched_block(NULL);
+	((struct Trapframe *)KSTACKTOP - 1)->regs[2] = 0;
+	schedule(1);
+}
+
+/* Overview:
+ *   Create a channel of 'npages' pages shared by 'curenv' and 'peer_envid', mapping its pages
+ *   into 'curenv' from 'va' on (see 'kern/chan.c'). The peer maps them with 'sys_chan_attach'.
+ *
+ * Post-Condition:
+ *   Return the id of the channel on success.
+ *   Return -E_INVAL: 'npages' is 0 or above 'CHAN_MAX_PAGES', 'va' is not page-aligned or the
+ *   range is illegal, or 'peer_envid' is 'curenv'.
+ *   Return -E_BAD_ENV: 'peer_envid' does not exist.
+ *   Return -E_NO_MEM: no free channel or not enough memory.
+ */
+int sys_chan_create(u_int peer_envid, u_int npages, u_int va) {
+	struct Env *peer;
+
+	if (npages == 0 || npages > CHAN_MAX_PAGES || (va & (PAGE_SIZE - 1)) != 0 ||
+	    is_illegal_va_range(va, npages * PAGE_SIZE)) {
+		return -E_INVAL;
 	}
+	try(envid2env(peer_envid, &peer, 0));
+	if (peer == curenv) {
+		return -E_INVAL;
+	}
+	return channel_create(curenv, peer, npages, va);
+}
+
+/* Overview:
+ *   Map the pages of channel 'chanid', created for 'curenv' as the peer, from 'va' on.
+ *
+ * Post-Condition:
+ *   Return the number of pages of the channel on success.
+ *   Return -E_INVAL: 'va' is not page-aligned or the range is illegal, or 'curenv' is not the
+ *   peer of the channel or has already attached.
+ */
+int sys_chan_attach(int chanid, u_int va) {
+	int npages;
+
+	if ((npages = channel_npages(curenv, chanid)) < 0) {
+		return npages;
+	}
+	if ((va & (PAGE_SIZE - 1)) != 0 || is_illegal_va_range(va, npages * PAGE_SIZE)) {
+		return -E_INVAL;
+	}
+	return channel_attach(curenv, chanid, va);
+}
+
+/* Overview:
+ *   Ring the doorbell of channel 'chanid': post the notification 'bits' to its other endpoint,
+ *   as with 'sys_notify'. Being an endpoint allows posting any bits.
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_INVAL: 'curenv' is not an endpoint of the channel.
+ *   Return -E_BAD_ENV: the other endpoint is gone.
+ */
+int sys_chan_signal(int chanid, u_int bits) {
+	struct Env *e;
+	u_int peer;
+
+	try(channel_peer(curenv, chanid, &peer));
+	try(envid2env(peer, &e, 0));
+	notify_post(e, bits);
 	return 0;
 }
 
-// XXX: kernel does busy waiting here, blocking all envs
+/* Overview:
+ *   Detach 'curenv' from channel 'chanid'. The channel is freed once both endpoints are detached
+ *   (an env is detached from all its channels when it is destroyed).
+ *
+ * Post-Condition:
+ *   Return 0 on success.
+ *   Return -E_INVAL: 'curenv' is not an endpoint of the channel.
+ */
+int sys_chan_detach(int chanid) {
+	return channel_detach(curenv, chanid);
+}
+
+/* Overview:
+ *   Give the rest of the time slice of 'curenv' to 'envid', if it is runnable. Otherwise this is
+ *   the same as 'sys_yield'.
+ *
+ * Post-Condition:
+ *   Return 0 when 'curenv' is scheduled again.
+ *   Return -E_BAD_ENV: 'envid' does not exist.
+ */
+int sys_yield_to(u_int envid) {
+	struct Env *e;
+
+	try(envid2env(envid, &e, 0));
+	((struct Trapframe *)KSTACKTOP - 1)->regs[2] = 0;
+	if (e != curenv && e->env_status == ENV_RUNNABLE) {
+		sched_switch_to(e);
+	}
+	schedule(1);
+}
+
+/* Overview:
+ *   Block 'curenv' for 'ticks' timer ticks, letting other envs run.
+ *
+ * Post-Condition:
+ *   Return 0 when the time is up. With 'ticks' set to 0, this is the same as 'sys_yield'.
+ */
+int sys_sleep(u_int ticks) {
+	if (ticks != 0) {
+		sched_block(NULL);
+		kclock_arm(curenv, ticks);
+	}
+	((struct Trapframe *)KSTACKTOP - 1)->regs[2] = 0;
+	schedule(1);
+}
+
+/* Overview:
+ *   Return the low 32 bits of the CPU cycle counter. A timer tick lasts 'TIMER_INTERVAL' cycles.
+ */
+u_int sys_clock(void) {
+	return (u_int)kclock_cycles();
+}
+
+// Envs blocked in 'sys_cgetc', woken in FIFO order as characters arrive.
+static struct Env_wait_list cons_waiters = TAILQ_HEAD_INITIALIZER(cons_waiters);
+
+/* Overview:
+ *   Deliver pending console input to the envs blocked in 'sys_cgetc'.
+ *
+ * Post-Condition:
+ *   Returns non-zero if some env is still waiting for input.
+ */
+int cons_poll(void) {
+	struct Env *e;
+	int ch;
+
+	while ((e = TAILQ_FIRST(&cons_waiters)) != NULL && (ch = scancharc()) != 0) {
+		sched_wakeup(e, ch);
+	}
+	return e != NULL;
+}
+
+/* Overview:
+ *   Read a character from the console. If no input is available, 'curenv' is blocked until
+ *   one arrives, while other envs keep running.
+ */
 int sys_cgetc(void) {
 	int ch;
-	while ((ch = scancharc()) == 0) {
+
+	if ((ch = scancharc()) != 0) {
+		return ch;
 	}
-	return ch;
+	sched_block(&cons_waiters);
+	((struct Trapframe *)KSTACKTOP - 1)->regs[2] = 0;
+	schedule(1);
 }
 
 /* Overview:
@@ -574,34 +1403,70 @@ u_int sys_get_parent_id(u_int envid) {
     return e->env_parent_id;
 }
 
-void *syscall_table[MAX_SYSNO] = {
-    [SYS_putchar] = sys_putchar,
-    [SYS_print_cons] = sys_print_cons,
-    [SYS_getenvid] = sys_getenvid,
-    [SYS_yield] = sys_yield,
-    [SYS_env_destroy] = sys_env_destroy,
-    [SYS_set_tlb_mod_entry] = sys_set_tlb_mod_entry,
-    [SYS_mem_alloc] = sys_mem_alloc,
-    [SYS_mem_map] = sys_mem_map,
-    [SYS_mem_unmap] = sys_mem_unmap,
-    [SYS_exofork] = sys_exofork,
-    [SYS_set_env_status] = sys_set_env_status,
-    [SYS_set_trapframe] = sys_set_trapframe,
-    [SYS_panic] = sys_panic,
-    [SYS_ipc_try_send] = sys_ipc_try_send,
-    [SYS_ipc_recv] = sys_ipc_recv,
-    [SYS_cgetc] = sys_cgetc,
-    [SYS_write_dev] = sys_write_dev,
-    [SYS_read_dev] = sys_read_dev,
-	[SYS_get_cur_path] = sys_get_cur_path,
-	[SYS_set_cur_path] = sys_set_cur_path,
-	[SYS_alloc_shell_id] = sys_alloc_shell_id,
-	[SYS_declare_var] = sys_declare_var,
-	[SYS_unset_var] = sys_unset_var,
-	[SYS_get_var] = sys_get_var,
-	[SYS_get_all_var] = sys_get_all_var,
-	[SYS_get_parent_id] = sys_get_parent_id,
-};
+// Syscalls which may be run in a batch by 'sys_submit', as a bit mask indexed by syscall number.
+// They must never block or switch envs.
+static const u_int syscall_batch = 1 << SYS_set_tlb_mod_entry | 1 << SYS_mem_alloc |
+				   1 << SYS_mem_map | 1 << SYS_mem_unmap | 1 << SYS_ipc_try_send |
+				   1 << SYS_write_dev | 1 << SYS_read_dev;
+
+extern void *syscall_table[MAX_SYSNO];
+
+/* Overview:
+ *   Run the batch of 'n' syscalls described by the entries at 'sqva', in order, posting the
+ *   return value of each one to its 'sqe_ret'. The batch stops at the first syscall returning an
+ *   error.
+ *
+ * Pre-Condition:
+ *   The entries are writable by 'curenv' and stay so while the batch runs (e.g. it does not remap
+ *   them copy-on-write).
+ *
+ * Post-Condition:
+ *   Return the number of syscalls that succeeded. If below 'n', the error of the next one is in
+ *   its 'sqe_ret': -E_NO_SYS if it may not be run in a batch (see 'syscall_batch').
+ *   Return -E_INVAL: 'n' is above 'SQE_MAX', or the entries are not legal memory.
+ *
+ * Hint:
+ *   One trap into the kernel is shared by the whole batch, like the many 'sys_mem_map' of 'fork'.
+ */
+int sys_submit(u_int sqva, u_int n) {
+	int (*func)(u_int, u_int, u_int, u_int, u_int, u_int);
+	struct Sqe *sqe = (struct Sqe *)sqva;
+	u_int i;
+
+	if (n > SQE_MAX || is_illegal_va_range(sqva, n * sizeof(struct Sqe))) {
+		return -E_INVAL;
+	}
+	for (i = 0; i < n; i++, sqe++) {
+		if (sqe->sqe_sysno >= 32 || !(syscall_batch & (1 << sqe->sqe_sysno))) {
+			sqe->sqe_ret = -E_NO_SYS;
+			break;
+		}
+		func = syscall_table[sqe->sqe_sysno];
+		sqe->sqe_ret = func(sqe->sqe_args[0], sqe->sqe_args[1], sqe->sqe_args[2],
+				    sqe->sqe_args[3], sqe->sqe_args[4], sqe->sqe_args[5]);
+		if (sqe->sqe_ret < 0) {
+			break;
+		}
+	}
+	return i;
+}
+
+#define SYSCALL_HANDLER(name, nargs) [SYS_##name] = sys_##name,
+#define SYSCALL_NARGS(name, nargs) [SYS_##name] = nargs,
+
+void *syscall_table[MAX_SYSNO] = {SYSCALL_LIST(SYSCALL_HANDLER)};
+
+// Number of arguments of each syscall, so that 'do_syscall' only fetches the ones passed on the
+// user stack (beyond the third) when they are used.
+static const u_char syscall_nargs[MAX_SYSNO] = {SYSCALL_LIST(SYSCALL_NARGS)};
+
+/*
+ * Syscalls taking the fast path of 'exc_gen_entry' (see 'handle_sys_fast'), as a bit mask indexed
+ * by syscall number. They must never block or switch envs, since only part of the user context
+ * is saved for them.
+ */
+const u_int syscall_fast = 1 << SYS_getenvid | 1 << SYS_mem_alloc | 1 << SYS_mem_map |
+			   1 << SYS_mem_unmap | 1 << SYS_ipc_try_send | 1 << SYS_clock;
 
 /* Overview:
  *   Call the function in 'syscall_table' indexed at 'sysno' with arguments from user context and
@@ -609,18 +1474,22 @@ void *syscall_table[MAX_SYSNO] = {
  *
  * Hint:
  *   Use sysno from $a0 to dispatch the syscall.
- *   The possible arguments are stored at $a1, $a2, $a3, [$sp + 16 bytes], [$sp + 20 bytes] in
- *   order.
- *   Number of arguments cannot exceed 5.
+ *   The possible arguments are stored at $a1, $a2, $a3, [$sp + 16 bytes], [$sp + 20 bytes],
+ *   [$sp + 24 bytes] in order.
+ *   Number of arguments cannot exceed 6. Only the ones the syscall takes (see 'syscall_nargs') are
+ *   read from the user stack.
+ *   For the syscalls in 'syscall_fast', 'tf' is the partial frame saved by 'handle_sys_fast'.
  */
 void do_syscall(struct Trapframe *tf) {
-	int (*func)(u_int, u_int, u_int, u_int, u_int);
+	int (*func)(u_int, u_int, u_int, u_int, u_int, u_int);
 	int sysno = tf->regs[4];
 	if (sysno < 0 || sysno >= MAX_SYSNO) {
 		tf->regs[2] = -E_NO_SYS;
 		return;
 	}
 
+	curenv->env_syscalls++;
+
 	/* Step 1: Add the EPC in 'tf' by a word (size of an instruction). */
 	/* Exercise 4.2: Your code here. (1/4) */
 	tf->cp0_epc += 4;
@@ -632,13 +1501,22 @@ void do_syscall(struct Trapframe *tf) {
 	u_int arg2 = tf->regs[6];
 	u_int arg3 = tf->regs[7];
 
-	/* Step 4: Last 2 args are stored in stack at [$sp + 16 bytes], [$sp + 20 bytes]. */
-	u_int arg4, arg5;
+	/* Step 4: Last 3 args are stored in stack at [$sp + 16 bytes], [$sp + 20 bytes],
+	 * [$sp + 24 bytes]. */
+	u_int arg4 = 0, arg5 = 0, arg6 = 0;
 	/* Exercise 4.2: Your code here. (3/4) */
-	arg4 = *(u_int *)(tf->regs[29] + 16);
-	arg5 = *(u_int *)(tf->regs[29] + 20);
+	switch (syscall_nargs[sysno]) {
+	case 6:
+		arg6 = *(u_int *)(tf->regs[29] + 24);
+		/* fallthrough */
+	case 5:
+		arg5 = *(u_int *)(tf->regs[29] + 20);
+		/* fallthrough */
+	case 4:
+		arg4 = *(u_int *)(tf->regs[29] + 16);
+	}
 	/* Step 5: Invoke 'func' with retrieved arguments and store its return value to $v0 in 'tf'.
 	 */
 	/* Exercise 4.2: Your code here. (4/4) */
-	tf->regs[2] = func(arg1, arg2, arg3, arg4, arg5);
+	tf->regs[2] = func(arg1, arg2, arg3, arg4, arg5, arg6);
 }
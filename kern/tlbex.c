@@ -15,6 +15,25 @@ void tlb_invalidate(u_int asid, u_long va) {
 }
 /* End of Key Code "tlb_invalidate" */
 
+/* Overview:
+ *   Invalidate the TLB entries with 'asid' mapping any of the 'npages' pages from 'va' on.
+ *
+ * Hint:
+ *   Each entry maps a pair of pages, so one probe per pair is enough. For more pairs than the TLB
+ *   has entries, going through the entries once ('tlb_flush_asid') is cheaper.
+ */
+void tlb_invalidate_range(u_int asid, u_long va, u_int npages) {
+	u_long end = va + npages * PAGE_SIZE;
+
+	if (npages > 2 * NTLB) {
+		tlb_flush_asid(asid);
+		return;
+	}
+	for (va = ROUNDDOWN(va, 2 * PAGE_SIZE); va < end; va += 2 * PAGE_SIZE) {
+		tlb_invalidate(asid, va);
+	}
+}
+
 static void passive_alloc(u_int va, Pde *pgdir, u_int asid) {
 	struct Page *p = NULL;
 
@@ -43,7 +62,44 @@ static void passive_alloc(u_int va, Pde *pgdir, u_int asid) {
 }
 
 /* Overview:
- *  Refill TLB.
+ *   Fill 'pentrylo' with the pair of large pages around 'va', if the page table entry '*ppte' of
+ *   'va' is part of a large page, and set CP0_PAGEMASK for them. 'do_tlb_refill' resets it once
+ *   the TLB entry is written.
+ *
+ * Post-Condition:
+ *   Return non-zero on success, or 0 if any page of the pair is mapped as an ordinary page, or
+ *   only part of a half is mapped: 'va' is then refilled as an ordinary page.
+ */
+static int tlb_refill_large(u_long *pentrylo, u_int va, u_int asid, Pte *ppte) {
+	Pte *pair = ppte - (PTX(va) & (2 * LARGE_NPAGES - 1));
+	u_long base = va & ~(2 * LARGE_PAGE_SIZE - 1), v;
+	int i;
+
+	// Each half must be a whole large page or wholly unmapped, or the TLB entry written for it
+	// would not match the page table.
+	for (i = 0; i < 2 * LARGE_NPAGES; i++) {
+		if (((pair[i] & PTE_V) && !(pair[i] & PTE_LARGE)) ||
+		    ((pair[i] ^ pair[i & ~(LARGE_NPAGES - 1)]) & PTE_V)) {
+			return 0;
+		}
+	}
+	// Entries of ordinary pages in the pair would overlap the large one.
+	for (v = base; v < base + 2 * LARGE_PAGE_SIZE; v += 2 * PAGE_SIZE) {
+		tlb_invalidate(asid, v);
+	}
+	pentrylo[0] = pair[0] >> 6;
+	pentrylo[1] = pair[LARGE_NPAGES] >> 6;
+	asm volatile("mtc0 %0, $5" : : "r"(PAGEMASK_LARGE));
+	return 1;
+}
+
+// The counter charged by the refill handler in 'kern/entry.S': that of 'curenv' (see 'env_run').
+static u_int tlb_refills_nobody;
+u_int *cur_tlb_refills = &tlb_refills_nobody;
+
+/* Overview:
+ *  Refill TLB, for the misses 'tlb_miss_entry' leaves to the general exception path, and for
+ *  invalid TLB entries.
  */
 void _do_tlb_refill(u_long *pentrylo, u_int va, u_int asid) {
 	tlb_invalidate(asid, va);
@@ -60,15 +116,44 @@ void _do_tlb_refill(u_long *pentrylo, u_int va, u_int asid) {
 	while (page_lookup(cur_pgdir, va, &ppte) == NULL) {
 		passive_alloc(va, cur_pgdir, asid);
 	}
+	if (curenv != NULL) {
+		curenv->env_tlb_refills++;
+	}
+	if ((*ppte & PTE_LARGE) && tlb_refill_large(pentrylo, va, asid, ppte)) {
+		return;
+	}
 	ppte = (Pte *)((u_long)ppte & ~0x7);
 	pentrylo[0] = ppte[0] >> 6;
 	pentrylo[1] = ppte[1] >> 6;
 }
 
 #if !defined(LAB) || LAB >= 4
+/* Overview:
+ *   Resolve a write to the copy-on-write page at 'va' of 'curenv', of which '*pte' is the entry:
+ *   map a private writable copy of the page there, or only make the page writable if no other
+ *   mapping shares it.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or -E_NO_MEM if there is no free page for the copy.
+ */
+static int cow_resolve(u_long va, Pte *pte) {
+	struct Page *pp = pa2page(*pte), *np;
+	u_int perm = (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_D;
+
+	if (pp->pp_ref > 1) {
+		// The copy overwrites the whole page: it does not need zeroing first.
+		try(page_alloc_nozero(&np));
+		memcpy((void *)page2kva(np), (void *)page2kva(pp), PAGE_SIZE);
+		pp = np;
+	}
+	// Remapping the same page only changes its permission.
+	return page_insert(curenv->env_pgdir, curenv->env_asid, pp, va, perm);
+}
+
 /* Overview:
  *   This is the TLB Mod exception handler in kernel.
- *   Our kernel allows user programs to handle TLB Mod exception in user mode, so we copy its
+ *   A write to a copy-on-write page ('PTE_COW') is resolved here, with 'cow_resolve'. Our kernel
+ *   allows user programs to handle the other TLB Mod exceptions in user mode, so we copy its
  *   context 'tf' into UXSTACK and modify the EPC to the registered user exception entry.
  *
  * Hints:
@@ -79,14 +164,23 @@ void _do_tlb_refill(u_long *pentrylo, u_int va, u_int asid) {
  */
 void do_tlb_mod(struct Trapframe *tf) {
 	struct Trapframe tmp_tf = *tf;
+	Pte *pte;
+
+	if (page_lookup(curenv->env_pgdir, tf->cp0_badvaddr, &pte) != NULL && (*pte & PTE_COW)) {
+		if (cow_resolve(tf->cp0_badvaddr, pte) == 0) {
+			curenv->env_cow_faults++;
+			return;
+		}
+		printk("[%08x] out of memory for a copy-on-write page at %08x\n", curenv->env_id,
+		       tf->cp0_badvaddr);
+		env_destroy(curenv);
+	}
 
 	if (tf->regs[29] < USTACKTOP || tf->regs[29] >= UXSTACKTOP) {
 		tf->regs[29] = UXSTACKTOP;
 	}
 	tf->regs[29] -= sizeof(struct Trapframe);
 	*(struct Trapframe *)tf->regs[29] = tmp_tf;
-	Pte *pte;
-	page_lookup(cur_pgdir, tf->cp0_badvaddr, &pte);
 	if (curenv->env_user_tlb_mod_entry) {
 		tf->regs[4] = tf->regs[29];
 		tf->regs[29] -= sizeof(tf->regs[4]);
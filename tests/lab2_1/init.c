@@ -18,9 +18,7 @@ void physical_memory_manage_strong_check(void) {
 	assert(pp4 && pp4 != pp3 && pp4 != pp2 && pp4 != pp1 && pp4 != pp0);
 
 	// temporarily steal the rest of the free pages
-	fl = page_free_list;
-	// now this page_free list must be empty!!!!
-	LIST_INIT(&page_free_list);
+	page_steal_all(&fl);
 	// should be no free memory
 	assert(page_alloc(&pp) == -E_NO_MEM);
 
@@ -40,7 +38,7 @@ void physical_memory_manage_strong_check(void) {
 	// pp0 should be zero
 	assert(*temp1 == 0);
 
-	page_free_list = fl;
+	page_free_all(&fl);
 	page_free(pp0);
 	page_free(pp1);
 	page_free(pp2);
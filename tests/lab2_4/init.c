@@ -0,0 +1,129 @@
+#include <pmap.h>
+#include <slab.h>
+
+#define OBJ_MAGIC 0x51ab51ab
+#define NOBJ 300
+
+struct Obj {
+	u_int o_magic; // set by the constructor
+	u_int o_val;   // 0 in the constructed state
+	u_char o_data[40];
+};
+
+static u_int nctor;
+
+static void obj_ctor(void *p) {
+	struct Obj *o = p;
+
+	o->o_magic = OBJ_MAGIC;
+	o->o_val = 0;
+	nctor++;
+}
+
+static struct Kmem_cache obj_cache = KMEM_CACHE("obj", sizeof(struct Obj), obj_ctor);
+
+static struct Obj *objs[NOBJ];
+
+static u_int count_free(void) {
+	struct Page_list fl;
+	struct Page *pp;
+	u_int n = 0;
+
+	page_steal_all(&fl);
+	LIST_FOREACH (pp, &fl, pp_link) {
+		n++;
+	}
+	page_free_all(&fl);
+	return n;
+}
+
+static void cache_check(u_int nfree) {
+	struct Page_list fl;
+	u_int i, n;
+
+	// Objects are aligned, distinct, and each is constructed once, when its slab is created.
+	for (i = 0; i < NOBJ; i++) {
+		assert((objs[i] = kmem_cache_alloc(&obj_cache)) != NULL);
+		assert(((u_long)objs[i] & 7) == 0);
+		assert(objs[i]->o_magic == OBJ_MAGIC && objs[i]->o_val == 0);
+		objs[i]->o_val = i + 1;
+	}
+	for (i = 0; i < NOBJ; i++) {
+		assert(objs[i]->o_val == i + 1);
+	}
+	n = nctor;
+	assert(n >= NOBJ && n < NOBJ + PAGE_SIZE / sizeof(struct Obj));
+	printk("slab: %d objects constructed for %d allocated\n", n, NOBJ);
+
+	// Freed in their constructed state, objects are handed out again without being constructed
+	// again. Of the slabs left empty, only one is kept.
+	for (i = 0; i < NOBJ; i++) {
+		objs[i]->o_val = 0;
+		kmem_cache_free(&obj_cache, objs[i]);
+	}
+	assert(count_free() == nfree - 1);
+	for (i = 0; i < NOBJ; i++) {
+		assert((objs[i] = kmem_cache_alloc(&obj_cache)) != NULL);
+		assert(objs[i]->o_magic == OBJ_MAGIC && objs[i]->o_val == 0);
+	}
+	assert(nctor - n < n);
+	for (i = 0; i < NOBJ; i++) {
+		kmem_cache_free(&obj_cache, objs[i]);
+	}
+	assert(count_free() == nfree - 1);
+
+	// Without free memory, only the objects of the slab kept can be allocated.
+	page_steal_all(&fl);
+	for (n = 0; n < NOBJ && (objs[n] = kmem_cache_alloc(&obj_cache)) != NULL; n++) {
+	}
+	assert(n > 0 && n <= PAGE_SIZE / sizeof(struct Obj));
+	for (i = 0; i < n; i++) {
+		kmem_cache_free(&obj_cache, objs[i]);
+	}
+	page_free_all(&fl);
+	printk("slab: cache_check() passed\n");
+}
+
+static void kmalloc_check(void) {
+	static const u_int sizes[] = {1, 16, 17, 100, 1000, KMALLOC_MAX};
+	u_char *p[sizeof(sizes) / sizeof(sizes[0])], *q;
+	u_int i, j;
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		assert((p[i] = kmalloc(sizes[i])) != NULL);
+		memset(p[i], i + 1, sizes[i]);
+	}
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (j = 0; j < sizes[i]; j++) {
+			assert(p[i][j] == i + 1);
+		}
+		kfree(p[i]);
+	}
+	// Blocks of the same size do not overlap, and a freed block is reused first.
+	assert((p[0] = kmalloc(24)) != NULL && (p[1] = kmalloc(24)) != NULL);
+	assert(p[1] >= p[0] + 24 || p[0] >= p[1] + 24);
+	kfree(p[1]);
+	assert((q = kmalloc(32)) == p[1]);
+	kfree(q);
+	kfree(p[0]);
+	assert(kmalloc(KMALLOC_MAX + 1) == NULL);
+	kfree(NULL);
+	printk("slab: kmalloc_check() passed\n");
+}
+
+void slab_check(void) {
+	cache_check(count_free());
+	kmalloc_check();
+	printk("slab_check() succeeded!\n");
+}
+
+void mips_init(u_int argc, char **argv, char **penv, u_int ram_low_size) {
+	printk("init.c:\tmips_init() is called\n");
+
+	mips_detect_memory(ram_low_size);
+	mips_vm_init();
+	page_init();
+
+	slab_check();
+	halt();
+}
@@ -0,0 +1,64 @@
+// Check that 'ipc_send' blocks in the kernel until the target receives, that blocked senders are
+// served in FIFO order, and that they are failed when the target is destroyed. Also check the
+// message words sent along with the value.
+
+#include <lib.h>
+
+#define NSENDER 4
+
+int main() {
+	u_int who, val;
+	int senders[NSENDER], sink, child, i;
+
+	// Sender 'i' blocks on us at tick 'i + 1', long before we receive.
+	for (i = 0; i < NSENDER; i++) {
+		if ((senders[i] = fork()) == 0) {
+			syscall_sleep(i + 1);
+			ipc_send(env->env_parent_id, 100 + i, 0, 0);
+			syscall_env_destroy(0);
+		}
+	}
+	syscall_sleep(NSENDER + 10);
+	for (i = 0; i < NSENDER; i++) {
+		val = ipc_recv(&who, 0, 0);
+		debugf("received %d from %x\n", val, who);
+		user_assert(who == senders[i] && val == 100 + i);
+	}
+
+	// A send still blocked when its target is destroyed fails with -E_BAD_ENV.
+	if ((sink = fork()) == 0) {
+		syscall_sleep(5);
+		syscall_env_destroy(0);
+	}
+	if ((child = fork()) == 0) {
+		ipc_send(env->env_parent_id, syscall_ipc_send(sink, 0, 0, 0, 0), 0, 0);
+		syscall_env_destroy(0);
+	}
+	val = ipc_recv(&who, 0, 0);
+	user_assert(who == child && val == -E_BAD_ENV);
+
+	// Message words travel with the value, and a message without words clears them.
+	if ((child = fork()) == 0) {
+		struct Ipc_msg msg = {.len = IPC_MSG_WORDS};
+		for (i = 0; i < IPC_MSG_WORDS; i++) {
+			msg.words[i] = i * i;
+		}
+		panic_on(syscall_ipc_send(env->env_parent_id, 7, 0, 0, &msg));
+		msg.len = IPC_MSG_WORDS + 1;
+		user_assert(syscall_ipc_send(env->env_parent_id, 8, 0, 0, &msg) == -E_INVAL);
+		ipc_send(env->env_parent_id, 9, 0, 0);
+		syscall_env_destroy(0);
+	}
+	user_assert(ipc_recv(&who, 0, 0) == 7 && who == child);
+	user_assert(env->env_ipc_msg.len == IPC_MSG_WORDS);
+	for (i = 0; i < IPC_MSG_WORDS; i++) {
+		user_assert(env->env_ipc_msg.words[i] == i * i);
+	}
+	user_assert(ipc_recv(&who, 0, 0) == 9 && env->env_ipc_msg.len == 0);
+
+	// Sending to ourselves would never complete.
+	user_assert(syscall_ipc_send(syscall_getenvid(), 0, 0, 0, 0) == -E_INVAL);
+
+	debugf("ipc_fifo passed!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := ipc_fifo/1
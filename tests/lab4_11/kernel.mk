@@ -0,0 +1 @@
+init-envs := notify_check/1
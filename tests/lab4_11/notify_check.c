@@ -0,0 +1,46 @@
+// Check 'syscall_notify' and 'syscall_notify_wait'.
+
+#include <kclock.h>
+#include <lib.h>
+
+int main() {
+	u_int start, elapsed, who, got;
+	int child;
+
+	// Posted bits stay set until taken, and only the bits in the mask are taken.
+	panic_on(syscall_notify(syscall_getenvid(), 0x5));
+	user_assert(syscall_notify_wait(0x3, 0) == 0x1);
+	user_assert(syscall_notify_wait(0x7, 0) == 0x4);
+
+	// Nothing is posted within 3 ticks.
+	start = syscall_clock();
+	user_assert(syscall_notify_wait(0x2, 3) == 0);
+	elapsed = syscall_clock() - start;
+	user_assert(elapsed >= 2 * TIMER_INTERVAL);
+
+	// The child blocks until we post one of the bits it waits for; the others stay pending.
+	if ((child = fork()) == 0) {
+		got = syscall_notify_wait(0x10, 0);
+		ipc_send(env->env_parent_id, got, 0, 0);
+		ipc_send(env->env_parent_id, syscall_notify_wait(0x20, 0), 0, 0);
+		syscall_env_destroy(0);
+	}
+	syscall_sleep(3);
+	panic_on(syscall_notify(child, 0x30));
+	user_assert(ipc_recv(&who, 0, 0) == 0x10 && who == child);
+	user_assert(ipc_recv(&who, 0, 0) == 0x20 && who == child);
+
+	// Only the bits in 'NOTIFY_ANY' may be posted to an env other than ourselves or a child.
+	if ((child = fork()) == 0) {
+		user_assert(syscall_notify(env->env_parent_id, 0x1) == -E_BAD_ENV);
+		panic_on(syscall_notify(env->env_parent_id, NOTIFY_PIPE));
+		ipc_send(env->env_parent_id, 0, 0, 0);
+		syscall_env_destroy(0);
+	}
+	ipc_recv(0, 0, 0);
+	user_assert(syscall_notify_wait(0x1 | NOTIFY_PIPE, 0) == NOTIFY_PIPE);
+
+	user_assert(syscall_notify(0x7fffffff, 1) == -E_BAD_ENV);
+	debugf("notify_check passed!\n");
+	return 0;
+}
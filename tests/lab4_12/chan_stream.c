@@ -0,0 +1,74 @@
+// Stream data over a shared-memory channel, checking it on the other side, and report the cost
+// of the transfer and the number of syscalls it took.
+
+#include <lib.h>
+
+#define STREAM_BYTES (1024 * 1024)
+
+static u_char buf[4096];
+
+static u_char pattern(u_int i) {
+	return (u_char)(i * 7 + (i >> 8));
+}
+
+static void receiver(void) {
+	struct Chan c;
+	u_int chanid, total = 0, syscalls, i;
+	int n;
+
+	chanid = ipc_recv(0, 0, 0);
+	panic_on(chan_attach(chanid, &c));
+	user_assert(chan_attach(chanid, &c) == -E_INVAL);
+
+	syscalls = env->env_syscalls;
+	// Read in odd sizes, so that reads straddle the end of the ring. The ring counters start 64KB
+	// below 2^32, so the stream also crosses their wrap.
+	while ((n = chan_recv(&c, buf, 1000)) > 0) {
+		for (i = 0; i < n; i++) {
+			if (buf[i] != pattern(total + i)) {
+				user_panic("byte %d: got %d, expected %d", total + i, buf[i],
+					   pattern(total + i));
+			}
+		}
+		total += n;
+	}
+	user_assert(total == STREAM_BYTES);
+	debugf("receiver: %d bytes in %d syscalls\n", total, env->env_syscalls - syscalls);
+	chan_close(&c);
+	ipc_send(env->env_parent_id, total, 0, 0);
+	syscall_env_destroy(0);
+}
+
+int main() {
+	struct Chan c;
+	u_int total, start, cycles, syscalls, i, n;
+	int child;
+
+	if ((child = fork()) == 0) {
+		receiver();
+	}
+	panic_on(chan_create(child, 4, &c));
+	// Only the peer may attach.
+	user_assert(syscall_chan_attach(c.c_id, (void *)(CHANBASE + PDMAP / 2)) == -E_INVAL);
+	ipc_send(child, c.c_id, 0, 0);
+
+	start = syscall_clock();
+	syscalls = env->env_syscalls;
+	for (total = 0; total < STREAM_BYTES; total += n) {
+		n = MIN(sizeof(buf), STREAM_BYTES - total);
+		for (i = 0; i < n; i++) {
+			buf[i] = pattern(total + i);
+		}
+		user_assert(chan_send(&c, buf, n) == n);
+	}
+	cycles = syscall_clock() - start;
+	debugf("sender: %d bytes in %d syscalls, %d cycles/KB\n", total,
+	       env->env_syscalls - syscalls - 1, cycles / (STREAM_BYTES / 1024));
+	chan_close(&c);
+	user_assert(ipc_recv(0, 0, 0) == STREAM_BYTES);
+
+	// Both ends are detached, so the channel is freed.
+	user_assert(syscall_chan_signal(c.c_id, NOTIFY_CHAN) == -E_INVAL);
+	debugf("chan_stream passed!\n");
+	return 0;
+}
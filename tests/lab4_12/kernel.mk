@@ -0,0 +1 @@
+init-envs := chan_stream/1
@@ -0,0 +1,99 @@
+// Check vectored IPC ('syscall_ipc_sendv', 'syscall_ipc_recvv', 'ipc_callv' and
+// 'ipc_replyv_wait'), and compare sending 16 pages with one message against 16 messages.
+
+#include <lib.h>
+
+#define NPAGES IPC_MAX_PAGES
+#define ROUNDS 50
+#define SRCVA 0x30000000
+#define DSTVA 0x40000000
+
+static struct Ipc_page iov[NPAGES];
+
+static u_int *page(u_int base, u_int i) {
+	return (u_int *)(base + i * PAGE_SIZE);
+}
+
+// Receive messages in a window of 'npages' pages, reporting the number of pages received and
+// whether the i-th page received is the i-th page sent. Stop after a message with value 0.
+static void receiver(u_int npages) {
+	u_int who, i, ok;
+
+	do {
+		panic_on(syscall_ipc_recvv((void *)DSTVA, npages));
+		for (i = 0, ok = 1; i < env->env_ipc_npages; i++) {
+			ok = ok && *page(DSTVA, i) == i;
+		}
+		who = env->env_ipc_from;
+		ipc_send(who, ok ? env->env_ipc_npages : -1, 0, 0);
+	} while (env->env_ipc_value != 0);
+	syscall_env_destroy(0);
+}
+
+static void fill_iov(u_int n) {
+	u_int i;
+
+	for (i = 0; i < n; i++) {
+		iov[i].srcva = (u_int)page(SRCVA, i);
+		iov[i].dstoff = i * PAGE_SIZE;
+		iov[i].perm = PTE_D;
+	}
+}
+
+int main() {
+	u_int who, i, n, start, single, vectored;
+	int child;
+
+	for (i = 0; i < NPAGES; i++) {
+		panic_on(syscall_mem_alloc(0, page(SRCVA, i), PTE_D));
+		*page(SRCVA, i) = i;
+	}
+
+	// Pages out of the receive window are refused, and nothing is delivered.
+	if ((child = fork()) == 0) {
+		receiver(4);
+	}
+	fill_iov(5);
+	user_assert(syscall_ipc_sendv(child, 1, iov, 5, 0) == -E_INVAL);
+	iov[4].srcva = 0;
+	panic_on(syscall_ipc_sendv(child, 0, iov, 5, 0));
+	user_assert(ipc_recv(&who, 0, 0) == 4 && who == child);
+	user_assert(syscall_ipc_sendv(child, 0, iov, NPAGES + 1, 0) == -E_INVAL);
+
+	// A whole window in one message, against one message per page.
+	if ((child = fork()) == 0) {
+		receiver(NPAGES);
+	}
+	fill_iov(NPAGES);
+	start = syscall_clock();
+	for (n = 0; n < ROUNDS; n++) {
+		for (i = 0; i < NPAGES; i++) {
+			panic_on(syscall_ipc_sendv(child, 1, &iov[i], 1, 0));
+			user_assert(ipc_recv(0, 0, 0) == 1);
+		}
+	}
+	single = (syscall_clock() - start) / ROUNDS;
+	start = syscall_clock();
+	for (n = 0; n < ROUNDS; n++) {
+		panic_on(syscall_ipc_sendv(child, n + 1 < ROUNDS, iov, NPAGES, 0));
+		user_assert(ipc_recv(0, 0, 0) == NPAGES);
+	}
+	vectored = (syscall_clock() - start) / ROUNDS;
+	debugf("ipc_vec: %d pages: %u cycles one by one, %u cycles in one message\n", NPAGES,
+	       single, vectored);
+
+	// A server replies to a call with several pages at once.
+	if ((child = fork()) == 0) {
+		fill_iov(3);
+		ipc_replyv_wait(0, 0, 0, 0, &who, 0, 0);
+		ipc_replyv_wait(who, 7, iov, 3, &who, 0, 0);
+	}
+	user_assert(ipc_callv(child, 0, 0, (void *)DSTVA, NPAGES, &n) == 7 && n == 3);
+	for (i = 0; i < n; i++) {
+		user_assert(*page(DSTVA, i) == i);
+	}
+	panic_on(syscall_env_destroy(child));
+
+	debugf("ipc_vec passed!\n");
+	return 0;
+}
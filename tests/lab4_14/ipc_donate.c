@@ -0,0 +1,74 @@
+// Pass buffers down a pipeline of envs with 'PTE_DONATE': each stage gets the only mapping of the
+// page, updates it in place and hands it over to the next stage, without copies or unmaps.
+
+#include <lib.h>
+
+#define NSTAGES 3
+#define NBUFS 20
+#define BUFVA 0x30000000
+
+static int mapped(u_int va) {
+	return (vpd[PDX(va)] & PTE_V) && (vpt[VPN(va)] & PTE_V);
+}
+
+// Receive each buffer, add our stage number to it and donate it to 'next'.
+static void stage(u_int n, u_int next) {
+	u_int i, perm, *buf = (u_int *)BUFVA;
+
+	for (i = 0; i < NBUFS; i++) {
+		ipc_recv(0, buf, &perm);
+		user_assert(perm & PTE_DONATE);
+		user_assert(pageref(buf) == 1);
+		buf[1] += n;
+		ipc_send(next, i, buf, PTE_D | PTE_DONATE);
+		user_assert(!mapped(BUFVA));
+	}
+	syscall_env_destroy(0);
+}
+
+int main() {
+	u_int i, n, next, *buf = (u_int *)BUFVA;
+	struct Ipc_page iov[2];
+
+	next = env->env_id;
+	for (n = NSTAGES; n > 0; n--) {
+		if ((i = fork()) == 0) {
+			stage(n, next);
+		}
+		next = i;
+	}
+
+	for (i = 0; i < NBUFS; i++) {
+		panic_on(syscall_mem_alloc(0, buf, PTE_D));
+		buf[0] = i;
+		ipc_send(next, i, buf, PTE_D | PTE_DONATE);
+		user_assert(!mapped(BUFVA));
+	}
+	for (i = 0; i < NBUFS; i++) {
+		ipc_recv(0, buf, 0);
+		user_assert(buf[0] == i && buf[1] == NSTAGES * (NSTAGES + 1) / 2);
+		user_assert(pageref(buf) == 1);
+	}
+
+	// Pages sent by 'syscall_ipc_sendv' can be donated too, each on its own.
+	panic_on(syscall_mem_unmap(0, buf));
+	if ((next = fork()) == 0) {
+		panic_on(syscall_ipc_recvv(buf, 2));
+		user_assert(env->env_ipc_npages == 2 && pageref(buf) == 1 &&
+			    pageref(buf + PAGE_SIZE / 4) == 2);
+		syscall_env_destroy(0);
+	}
+	panic_on(syscall_mem_alloc(0, buf, PTE_D));
+	panic_on(syscall_mem_alloc(0, buf + PAGE_SIZE / 4, PTE_D));
+	iov[0].srcva = BUFVA;
+	iov[0].dstoff = 0;
+	iov[0].perm = PTE_D | PTE_DONATE;
+	iov[1].srcva = BUFVA + PAGE_SIZE;
+	iov[1].dstoff = PAGE_SIZE;
+	iov[1].perm = PTE_D;
+	panic_on(syscall_ipc_sendv(next, 0, iov, 2, 0));
+	user_assert(!mapped(BUFVA) && mapped(BUFVA + PAGE_SIZE));
+
+	debugf("ipc_donate passed!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := ipc_donate/1
@@ -0,0 +1 @@
+init-envs := syscall_lat/1
@@ -0,0 +1 @@
+init-envs := submit_check/1
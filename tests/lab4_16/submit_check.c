@@ -0,0 +1,88 @@
+// Batched syscalls: check that a batch runs in order, stops at the first error and posts the
+// results, that a forked child gets its own submission page, and compare the cost of mapping
+// pages one syscall at a time and in batches.
+
+#include <lib.h>
+
+#define NPAGES SQE_MAX
+#define VA(i) (0x10000000 + (i) * PAGE_SIZE)
+#define VA2(i) (0x10800000 + (i) * PAGE_SIZE)
+
+static struct Sqe sqes[4] __attribute__((aligned(PAGE_SIZE)));
+
+static void sqe_set(struct Sqe *sqe, u_int sysno, u_int a1, u_int a2, u_int a3, u_int a4,
+		    u_int a5) {
+	sqe->sqe_sysno = sysno;
+	sqe->sqe_args[0] = a1;
+	sqe->sqe_args[1] = a2;
+	sqe->sqe_args[2] = a3;
+	sqe->sqe_args[3] = a4;
+	sqe->sqe_args[4] = a5;
+	sqe->sqe_ret = 1;
+}
+
+int main() {
+	u_int i, start, cycles;
+	int child, r;
+
+	// A batch stops at the first error, which is posted to its entry.
+	sqe_set(&sqes[0], SYS_mem_alloc, 0, VA(0), PTE_D, 0, 0);
+	sqe_set(&sqes[1], SYS_mem_map, 0, VA(0), 0, VA2(0), PTE_D);
+	sqe_set(&sqes[2], SYS_mem_map, 0, VA(1), 0, VA2(1), PTE_D);
+	sqe_set(&sqes[3], SYS_mem_unmap, 0, VA(0), 0, 0, 0);
+	r = syscall_submit(sqes, 4);
+	user_assert(r == 2);
+	user_assert(sqes[0].sqe_ret == 0 && sqes[1].sqe_ret == 0);
+	user_assert(sqes[2].sqe_ret == -E_INVAL && sqes[3].sqe_ret == 1);
+	*(int *)VA(0) = 0x5a5a;
+	user_assert(*(int *)VA2(0) == 0x5a5a);
+
+	// Syscalls which may block are refused.
+	sqe_set(&sqes[0], SYS_yield, 0, 0, 0, 0, 0);
+	user_assert(syscall_submit(sqes, 1) == 0 && sqes[0].sqe_ret == -E_NO_SYS);
+	user_assert(syscall_submit(sqes, SQE_MAX + 1) == -E_INVAL);
+
+	// The library queue.
+	for (i = 0; i < NPAGES; i++) {
+		panic_on(submit_add(SYS_mem_alloc, 0, VA(i), PTE_D, 0, 0));
+	}
+	panic_on(submit_flush());
+	for (i = 0; i < NPAGES; i++) {
+		*(u_int *)VA(i) = i;
+	}
+	panic_on(submit_add(SYS_mem_map, 0, VA(7), 0, VA(8), PTE_D));
+	panic_on(submit_add(SYS_mem_unmap, 0, VA(9), 0, 0, 0));
+	user_assert(submit_flush() == 0 && *(u_int *)VA(8) == 7);
+	user_assert(!(vpt[VPN(VA(9))] & PTE_V));
+	panic_on(submit_add(SYS_mem_map, 0, VA(9), 0, VA(10), PTE_D));
+	user_assert(submit_flush() == -E_INVAL);
+
+	// The child has its own submission page, which its batches do not share with ours.
+	if ((child = fork()) == 0) {
+		user_assert(!(vpt[VPN(SUBMITVA)] & PTE_V));
+		panic_on(submit_add(SYS_mem_unmap, 0, VA(0), 0, 0, 0));
+		panic_on(submit_flush());
+		user_assert((vpt[VPN(SUBMITVA)] & PTE_V) && !(vpt[VPN(VA(0))] & PTE_V));
+		return 0;
+	}
+	wait(child);
+	user_assert((vpt[VPN(VA(0))] & PTE_V) && *(u_int *)VA(0) == 0);
+
+	start = syscall_clock();
+	for (i = 0; i < NPAGES; i++) {
+		panic_on(syscall_mem_map(0, (void *)VA(i), 0, (void *)VA2(i), PTE_D));
+	}
+	cycles = syscall_clock() - start;
+	debugf("submit_check: %d mem_map one by one: %u cycles\n", NPAGES, cycles);
+
+	start = syscall_clock();
+	for (i = 0; i < NPAGES; i++) {
+		panic_on(submit_add(SYS_mem_map, 0, VA(i), 0, VA2(i), PTE_D));
+	}
+	panic_on(submit_flush());
+	cycles = syscall_clock() - start;
+	debugf("submit_check: %d mem_map in a batch: %u cycles\n", NPAGES, cycles);
+
+	debugf("submit_check passed!\n");
+	return 0;
+}
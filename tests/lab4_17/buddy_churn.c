@@ -0,0 +1,113 @@
+// Fragmentation under fork/exit churn: in each round, children copy pages of ours on write,
+// allocate pages of their own, and exit. Once they are gone, the buddy allocator has to have
+// coalesced all their pages back: the free memory is the same after the churn as before, and so is
+// the order of the largest free block.
+//
+// Free blocks are found in the 'pages' array, mapped read-only at 'UPAGES'. The pages the kernel
+// zeroed ahead of time while idle are counted as free too.
+
+#include <lib.h>
+
+#define ROUNDS 20
+#define NCHILDREN 8
+#define NTOUCH 16
+#define NALLOC 32
+
+struct Frag {
+	u_int nfree;			     // free pages
+	u_int nblocks[PAGE_MAX_ORDER + 1]; // free blocks of each order
+};
+
+static char buf[NTOUCH * PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+static int is_mapped(u_int va) {
+	return (vpd[PDX(va)] & PTE_V) && (vpt[VPN(va)] & PTE_V);
+}
+
+static int frag_max_order(struct Frag *f) {
+	int order;
+
+	for (order = PAGE_MAX_ORDER; order > 0 && f->nblocks[order] == 0; order--) {
+	}
+	return order;
+}
+
+static void frag_scan(struct Frag *f) {
+	u_int i, order;
+
+	memset(f, 0, sizeof(*f));
+	for (i = 0; is_mapped((u_int)&pages[i + 1] - 1); i++) {
+		if (pages[i].pp_free == PAGE_FREE) {
+			order = pages[i].pp_order;
+			f->nblocks[order]++;
+			f->nfree += 1 << order;
+		} else if (pages[i].pp_free == PAGE_ZEROED) {
+			f->nfree++;
+		}
+	}
+}
+
+static void frag_print(const char *when, struct Frag *f) {
+	int order;
+
+	debugf("buddy_churn: %s: %u free pages, blocks of order 0..%d:", when, f->nfree,
+	       PAGE_MAX_ORDER);
+	for (order = 0; order <= PAGE_MAX_ORDER; order++) {
+		debugf(" %u", f->nblocks[order]);
+	}
+	debugf("\n");
+}
+
+static void child(int n) {
+	u_int i;
+
+	for (i = 0; i < NTOUCH; i++) {
+		buf[i * PAGE_SIZE] = n;
+	}
+	for (i = 0; i < NALLOC; i++) {
+		panic_on(syscall_mem_alloc(0, (void *)(UTEXT + PDMAP * 16 + i * PAGE_SIZE), PTE_D));
+	}
+	exit(0);
+}
+
+static void churn(void) {
+	int children[NCHILDREN], n;
+	const volatile struct Env *e;
+
+	for (n = 0; n < NCHILDREN; n++) {
+		if ((children[n] = fork()) == 0) {
+			child(n);
+		}
+	}
+	for (n = 0; n < NCHILDREN; n++) {
+		wait(children[n]);
+		// The exit status is sent just before the child destroys itself.
+		e = &envs[ENVX(children[n])];
+		while (e->env_id == children[n] && e->env_status != ENV_FREE) {
+			syscall_yield();
+		}
+	}
+}
+
+int main() {
+	struct Frag before, after;
+	int round;
+
+	// A first round for the pages we keep (copies of ours, page tables).
+	churn();
+	frag_scan(&before);
+	frag_print("before", &before);
+	for (round = 0; round < ROUNDS; round++) {
+		churn();
+		frag_scan(&after);
+		if (round % 5 == 4) {
+			frag_print("churning", &after);
+		}
+	}
+	frag_print("after", &after);
+
+	user_assert(after.nfree == before.nfree);
+	user_assert(frag_max_order(&after) == frag_max_order(&before));
+	debugf("buddy_churn passed!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := buddy_churn/1
@@ -0,0 +1 @@
+init-envs := zero_pool/1
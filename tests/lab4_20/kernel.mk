@@ -0,0 +1 @@
+init-envs := tlb_large/1
@@ -0,0 +1,95 @@
+// Large pages: a region allocated with 'PTE_LARGE' is mapped by one TLB entry per pair of 64KB
+// pages instead of one per pair of 4KB pages. Count the TLB refills ('env_tlb_refills') of loops
+// touching every page of a region, with large and with ordinary pages, and of loops scanning the
+// 'pages' array (mapped with large pages at 'UPAGES') as 'pageref' does.
+//
+// Then check that a large page splits into ordinary ones when one of its pages is unmapped, and
+// that a child sees the contents of our large pages.
+
+#include <lib.h>
+
+#define NLARGE 8
+#define REGION_SIZE (NLARGE * LARGE_PAGE_SIZE)
+#define ROUNDS 50
+
+#define LARGE_VA (UTEXT + PDMAP * 16)
+#define SMALL_VA (UTEXT + PDMAP * 17)
+
+static u_int touch(u_int va, u_int size) {
+	u_int refills = env->env_tlb_refills, round, off, sum = 0;
+
+	for (round = 0; round < ROUNDS; round++) {
+		for (off = 0; off < size; off += PAGE_SIZE) {
+			sum += *(volatile u_int *)(va + off);
+		}
+	}
+	user_assert(sum == 0);
+	return env->env_tlb_refills - refills;
+}
+
+static u_int scan_pages(void) {
+	u_int refills = env->env_tlb_refills, round, i, sum = 0;
+
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 0; (vpt[VPN((u_int)&pages[i + 1] - 1)] & PTE_V); i += PAGE_SIZE / sizeof(*pages)) {
+			sum += pages[i].pp_ref;
+		}
+	}
+	user_assert(sum > 0);
+	return env->env_tlb_refills - refills;
+}
+
+static void check_split(void) {
+	u_int va = LARGE_VA, i;
+	int child;
+
+	for (i = 0; i < REGION_SIZE; i += PAGE_SIZE) {
+		*(u_int *)(va + i) = i;
+	}
+	for (i = 0; i < LARGE_NPAGES; i++) {
+		user_assert(vpt[VPN(va) + i] & PTE_LARGE);
+	}
+	panic_on(syscall_mem_unmap(0, (void *)(va + PAGE_SIZE)));
+	user_assert(!(vpt[VPN(va) + 1] & PTE_V));
+	for (i = 0; i < LARGE_NPAGES; i++) {
+		user_assert(!(vpt[VPN(va) + i] & PTE_LARGE));
+		if (i != 1) {
+			user_assert(*(u_int *)(va + i * PAGE_SIZE) == i * PAGE_SIZE);
+		}
+	}
+	user_assert(vpt[VPN(va) + LARGE_NPAGES] & PTE_LARGE);
+
+	if ((child = fork()) == 0) {
+		for (i = LARGE_NPAGES * PAGE_SIZE; i < REGION_SIZE; i += PAGE_SIZE) {
+			user_assert(*(u_int *)(va + i) == i);
+		}
+		exit(0);
+	}
+	user_assert(wait(child) == 0);
+	debugf("tlb_large: split ok\n");
+}
+
+int main() {
+	u_int i, large, small;
+
+	for (i = 0; i < NLARGE; i++) {
+		panic_on(syscall_mem_alloc(0, (void *)(LARGE_VA + i * LARGE_PAGE_SIZE),
+					   PTE_D | PTE_LARGE));
+	}
+	user_assert(syscall_mem_alloc(0, (void *)(LARGE_VA + PAGE_SIZE), PTE_D | PTE_LARGE) ==
+		    -E_INVAL);
+	for (i = 0; i < REGION_SIZE; i += PAGE_SIZE) {
+		panic_on(syscall_mem_alloc(0, (void *)(SMALL_VA + i), PTE_D));
+	}
+
+	large = touch(LARGE_VA, REGION_SIZE);
+	small = touch(SMALL_VA, REGION_SIZE);
+	debugf("tlb_large: %d rounds over %d KB: %d refills with large pages, %d with 4KB pages\n",
+	       ROUNDS, REGION_SIZE / 1024, large, small);
+	debugf("tlb_large: %d rounds over pages[]: %d refills\n", ROUNDS, scan_pages());
+	user_assert(large * 4 < small);
+
+	check_split();
+	debugf("tlb_large passed!\n");
+	return 0;
+}
@@ -0,0 +1,127 @@
+// Range memory syscalls: each one maps or unmaps many pages in a single trap. Check that they
+// behave as the single-page syscalls do for each page (across a page table boundary, skipping
+// holes, copy-on-write with 'MAP_COW'), and report the cycles saved against page-by-page loops.
+
+#include <lib.h>
+
+#define NPAGES 64
+
+// Both ranges cross a page table boundary.
+#define SRC (UTEXT + PDMAP * 16 - PAGE_SIZE * NPAGES / 2)
+#define DST (UTEXT + PDMAP * 20 - PAGE_SIZE * NPAGES / 2)
+#define PAGE(base, i) ((u_int *)((base) + (i) * PAGE_SIZE))
+
+static int mapped(u_int va) {
+	return (vpd[PDX(va)] & PTE_V) && (vpt[VPN(va)] & PTE_V);
+}
+
+static void range_check(void) {
+	u_int i, j;
+
+	// Allocated pages are zeroed and writable.
+	panic_on(syscall_mem_alloc_range(0, (void *)SRC, NPAGES, PTE_D));
+	for (i = 0; i < NPAGES; i++) {
+		for (j = 0; j < PAGE_SIZE / sizeof(u_int); j++) {
+			user_assert(PAGE(SRC, i)[j] == 0);
+		}
+		*PAGE(SRC, i) = i;
+	}
+
+	// Holes in the source are skipped, and the pages mapped are shared.
+	panic_on(syscall_mem_unmap_range(0, (void *)SRC, 2));
+	panic_on(syscall_mem_map_range(0, (void *)SRC, (void *)DST, NPAGES, 0));
+	user_assert(!mapped(DST) && !mapped(DST + PAGE_SIZE));
+	for (i = 2; i < NPAGES; i++) {
+		user_assert(*PAGE(DST, i) == i);
+		user_assert(PTE_FLAGS(vpt[VPN(PAGE(DST, i))]) == PTE_FLAGS(vpt[VPN(PAGE(SRC, i))]));
+		*PAGE(DST, i) = i + 1;
+		user_assert(*PAGE(SRC, i) == i + 1);
+	}
+
+	// Overlapping ranges and illegal ones are rejected.
+	user_assert(syscall_mem_map_range(0, (void *)SRC, (void *)(SRC + PAGE_SIZE), 2, 0) ==
+		    -E_INVAL);
+	user_assert(syscall_mem_alloc_range(0, (void *)(UTOP - PAGE_SIZE), 2, PTE_D) == -E_INVAL);
+	user_assert(syscall_mem_unmap_range(0, (void *)(SRC + 1), 1) == -E_INVAL);
+
+	// With 'MAP_COW', both copies become copy-on-write.
+	panic_on(syscall_mem_map_range(0, (void *)SRC, (void *)DST, NPAGES, MAP_COW));
+	for (i = 2; i < NPAGES; i++) {
+		user_assert((vpt[VPN(PAGE(SRC, i))] & (PTE_COW | PTE_D)) == PTE_COW);
+		user_assert((vpt[VPN(PAGE(DST, i))] & (PTE_COW | PTE_D)) == PTE_COW);
+	}
+
+	panic_on(syscall_mem_unmap_range(0, (void *)SRC, NPAGES));
+	panic_on(syscall_mem_unmap_range(0, (void *)DST, NPAGES));
+	for (i = 0; i < NPAGES; i++) {
+		user_assert(!mapped(SRC + i * PAGE_SIZE) && !mapped(DST + i * PAGE_SIZE));
+	}
+	debugf("mem_range: range_check() passed\n");
+}
+
+static void bench(void) {
+	u_int i, start, loop, range;
+
+	// The page tables of the ranges are allocated (and kept) here, not while measuring.
+	panic_on(syscall_mem_alloc_range(0, (void *)SRC, NPAGES, PTE_D));
+	panic_on(syscall_mem_map_range(0, (void *)SRC, (void *)DST, NPAGES, 0));
+	panic_on(syscall_mem_unmap_range(0, (void *)DST, NPAGES));
+
+	start = syscall_clock();
+	for (i = 0; i < NPAGES; i++) {
+		panic_on(syscall_mem_map(0, PAGE(SRC, i), 0, PAGE(DST, i), PTE_D));
+	}
+	for (i = 0; i < NPAGES; i++) {
+		panic_on(syscall_mem_unmap(0, PAGE(DST, i)));
+	}
+	loop = syscall_clock() - start;
+
+	start = syscall_clock();
+	panic_on(syscall_mem_map_range(0, (void *)SRC, (void *)DST, NPAGES, 0));
+	panic_on(syscall_mem_unmap_range(0, (void *)DST, NPAGES));
+	range = syscall_clock() - start;
+
+	debugf("mem_range: mapping and unmapping %d pages: %u cycles page by page, %u by range\n",
+	       NPAGES, loop, range);
+	user_assert(range < loop);
+	panic_on(syscall_mem_unmap_range(0, (void *)SRC, NPAGES));
+}
+
+// 'dup' shares the data pages of an fd with a single 'MAP_LIBRARY' range syscall.
+static void dup_check(void) {
+	int p[2];
+	u_int va;
+	char c;
+
+	panic_on(pipe(p));
+	user_assert(dup(p[1], 10) == 10);
+	va = (u_int)fd2data((struct Fd *)INDEX2FD(10));
+	user_assert((vpt[VPN(va)] & (PTE_D | PTE_LIBRARY | PTE_COW | PTE_PRIVATE)) ==
+		    (PTE_D | PTE_LIBRARY));
+	user_assert(write(10, "x", 1) == 1);
+	user_assert(read(p[0], &c, 1) == 1 && c == 'x');
+	close(10);
+	close(p[0]);
+	close(p[1]);
+	debugf("mem_range: dup_check() passed\n");
+}
+
+int main() {
+	u_int child;
+
+	range_check();
+	dup_check();
+	bench();
+
+	// 'fork' maps the whole address space with a couple of range syscalls.
+	panic_on(syscall_mem_alloc_range(0, (void *)SRC, NPAGES, PTE_D));
+	*PAGE(SRC, NPAGES - 1) = 1;
+	if ((child = fork()) == 0) {
+		*PAGE(SRC, NPAGES - 1) = 2;
+		exit(0);
+	}
+	user_assert(wait(child) == 0);
+	user_assert(*PAGE(SRC, NPAGES - 1) == 1);
+	debugf("mem_range passed!\n");
+	return 0;
+}
@@ -0,0 +1,55 @@
+// Fork latency against the size of the address space: 'fork' duplicates it in the kernel with a
+// single 'sys_fork', 'user_fork' with 'sys_exofork' and the syscalls after it. The time is taken
+// in the parent, from the call until it returns the child's envid.
+
+#include <lib.h>
+
+#define HEAP (UTEXT + PDMAP * 16)
+#define HEAP_MAGIC 0xf0f0f0f0
+
+#define NSIZES 4
+
+static const u_int sizes[NSIZES] = {0, 64, 256, 1024};
+
+// A fresh heap of 'npages' writable pages, not copy-on-write yet.
+static void heap_reset(u_int npages) {
+	u_int i;
+
+	panic_on(syscall_mem_unmap_range(0, (void *)HEAP, sizes[NSIZES - 1]));
+	panic_on(syscall_mem_alloc_range(0, (void *)HEAP, npages, PTE_D));
+	for (i = 0; i < npages; i++) {
+		((u_int *)HEAP)[i * PAGE_SIZE / sizeof(u_int)] = HEAP_MAGIC;
+	}
+}
+
+static u_int fork_cycles(int (*f)(void), u_int npages) {
+	u_int start, cycles, i;
+	int child;
+
+	heap_reset(npages);
+	start = syscall_clock();
+	if ((child = f()) == 0) {
+		for (i = 0; i < npages; i++) {
+			user_assert(((u_int *)HEAP)[i * PAGE_SIZE / sizeof(u_int)] == HEAP_MAGIC);
+		}
+		exit(0);
+	}
+	cycles = syscall_clock() - start;
+	user_assert(child > 0);
+	user_assert(wait(child) == 0);
+	return cycles;
+}
+
+int main() {
+	u_int i, kern, user;
+
+	for (i = 0; i < NSIZES; i++) {
+		kern = fork_cycles(fork, sizes[i]);
+		user = fork_cycles(user_fork, sizes[i]);
+		debugf("fork_bench: %4u heap pages: %8u cycles with sys_fork, %8u with user_fork\n",
+		       sizes[i], kern, user);
+		user_assert(kern < user);
+	}
+	debugf("fork_bench passed!\n");
+	return 0;
+}
@@ -0,0 +1,83 @@
+// Copy-on-write faults are resolved by the kernel within the TLB Mod exception, without going
+// through the user handler and its syscalls. A page still shared with a child is copied, and a
+// page no longer shared is only made writable again. Report the cycles per fault of both.
+
+#include <lib.h>
+
+#define NPAGES 64
+#define VA(i) ((u_int *)(UTEXT + PDMAP * 16 + (i) * PAGE_SIZE))
+
+static u_int write_all(u_int val) {
+	u_int i, syscalls, faults, start, cycles;
+
+	start = syscall_clock();
+	syscalls = env->env_syscalls;
+	faults = env->env_cow_faults;
+	for (i = 0; i < NPAGES; i++) {
+		*VA(i) = val;
+	}
+	user_assert(env->env_syscalls == syscalls);
+	user_assert(env->env_cow_faults == faults + NPAGES);
+	cycles = syscall_clock() - start;
+	for (i = 0; i < NPAGES; i++) {
+		user_assert(*VA(i) == val);
+		user_assert((vpt[VPN(VA(i))] & (PTE_COW | PTE_D)) == PTE_D);
+	}
+	return cycles / NPAGES;
+}
+
+// 'wait' returns once the child has exited: also let it be destroyed, dropping its mappings.
+static void reap(u_int child) {
+	user_assert(wait(child) == 0);
+	while (envs[ENVX(child)].env_id == child && envs[ENVX(child)].env_status != ENV_FREE) {
+		syscall_yield();
+	}
+}
+
+int main() {
+	u_int i, child, pa[NPAGES], copy, flip;
+
+	panic_on(syscall_mem_alloc_range(0, VA(0), NPAGES, PTE_D));
+	for (i = 0; i < NPAGES; i++) {
+		*VA(i) = 1;
+	}
+
+	if ((child = fork()) == 0) {
+		ipc_recv(0, 0, 0);
+		for (i = 0; i < NPAGES; i++) {
+			user_assert(*VA(i) == 1);
+		}
+		exit(0);
+	}
+
+	// Shared with the child: each page is copied.
+	for (i = 0; i < NPAGES; i++) {
+		pa[i] = PTE_ADDR(vpt[VPN(VA(i))]);
+	}
+	copy = write_all(2);
+	for (i = 0; i < NPAGES; i++) {
+		user_assert(PTE_ADDR(vpt[VPN(VA(i))]) != pa[i]);
+	}
+	ipc_send(child, 0, 0, 0);
+	reap(child);
+
+	// Once the child is gone, its copies are freed: fork again, and let the child exit at once,
+	// so that our pages are copy-on-write but not shared anymore.
+	if ((child = fork()) == 0) {
+		exit(0);
+	}
+	reap(child);
+	for (i = 0; i < NPAGES; i++) {
+		pa[i] = PTE_ADDR(vpt[VPN(VA(i))]);
+	}
+	flip = write_all(3);
+	for (i = 0; i < NPAGES; i++) {
+		user_assert(PTE_ADDR(vpt[VPN(VA(i))]) == pa[i]);
+	}
+
+	debugf("cow_fault: %u cycles per fault copying the page, %u making it writable\n", copy,
+	       flip);
+	user_assert(flip < copy);
+	debugf("cow_fault passed!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := cow_fault/1
@@ -0,0 +1,46 @@
+// More envs than ASIDs: fork 'NCHILD' children, which all run and stay alive together. Their ASIDs
+// come from several generations (visible in the bits of 'env_asid' above the hardware ASID), and
+// each still sees its own memory once the others have run.
+
+#include <lib.h>
+
+#define NCHILD (NASID + NASID / 2)
+
+static volatile u_int val;
+static u_int children[NCHILD];
+
+int main() {
+	u_int i, gen, gen_min = ~0, gen_max = 0;
+	int child;
+
+	for (i = 0; i < NCHILD; i++) {
+		if ((child = fork()) == 0) {
+			val = i + 1;
+			ipc_recv(0, 0, 0);
+			user_assert(val == i + 1);
+			exit(0);
+		}
+		user_assert(child > 0);
+		children[i] = child;
+	}
+	debugf("asid_gen: %d children forked\n", NCHILD);
+
+	// Each child has run up to 'ipc_recv', so it has been given an ASID.
+	for (i = 0; i < NCHILD; i++) {
+		while (envs[ENVX(children[i])].env_ipc_recving == 0) {
+			syscall_yield();
+		}
+		gen = envs[ENVX(children[i])].env_asid / NASID;
+		gen_min = MIN(gen_min, gen);
+		gen_max = gen > gen_max ? gen : gen_max;
+	}
+	debugf("asid_gen: ASID generations %u to %u\n", gen_min, gen_max);
+	user_assert(gen_max > gen_min);
+
+	for (i = 0; i < NCHILD; i++) {
+		ipc_send(children[i], 0, 0, 0);
+		user_assert(wait(children[i]) == 0);
+	}
+	debugf("asid_gen passed!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := asid_gen/1
@@ -0,0 +1 @@
+init-envs := tlb_refill/1
@@ -0,0 +1,2 @@
+init-envs := mlfq_check/1
+sched := mlfq
@@ -0,0 +1,82 @@
+// Check the MLFQ policy: envs that give up the CPU before using up their time slice stay at the
+// top level, a CPU hog sinks below them and gets little CPU time, and the periodic boost keeps it
+// from starving. 'kernel.mk' builds the kernel with 'sched=mlfq'.
+
+#include <lib.h>
+#include <sched.h>
+
+#if MOS_SCHED_POLICY != SCHED_MLFQ
+#error "mlfq_check needs the MLFQ policy (sched=mlfq)"
+#endif
+
+#define NGAMERS 2
+#define WINDOW (2 * SCHED_BOOST_TICKS + 20)
+
+static volatile int done[1024] __attribute__((aligned(4096)));
+
+static void hog(void) {
+	while (!done[0]) {
+	}
+	exit(0);
+}
+
+// Keep the CPU busy in bursts far shorter than the shortest time slice, yielding after each.
+static void gamer(void) {
+	u_int start;
+
+	while (!done[0]) {
+		start = syscall_clock();
+		while (syscall_clock() - start < SCHED_QUANTUM_MIN / 8) {
+		}
+		syscall_yield();
+	}
+	exit(0);
+}
+
+// Low 32 bits of the CPU time of 'envid', as 'top' reads them: enough for differences.
+static u_int cputime(u_int envid) {
+	return (u_int)envs[ENVX(envid)].env_utime + (u_int)envs[ENVX(envid)].env_ktime;
+}
+
+int main() {
+	u_int hogid, gamers[NGAMERS], i, before, used;
+
+	// Share 'done' with all children, so that they can be stopped.
+	panic_on(syscall_mem_alloc(0, (void *)done, PTE_D | PTE_LIBRARY));
+
+	// Alone, the hog uses up its time slices and sinks.
+	if ((hogid = fork()) == 0) {
+		hog();
+	}
+	syscall_sleep(20);
+
+	for (i = 0; i < NGAMERS; i++) {
+		if ((gamers[i] = fork()) == 0) {
+			gamer();
+		}
+	}
+	syscall_sleep(10);
+
+	// The gamers keep the top level busy. The hog only runs after the boosts, so it gets some CPU
+	// time, but far less than the third it would get with round-robin.
+	before = cputime(hogid);
+	syscall_sleep(WINDOW);
+	used = (cputime(hogid) - before) / TIMER_INTERVAL;
+	debugf("mlfq_check: the hog ran %u of %u ticks\n", used, WINDOW);
+	user_assert(cputime(hogid) != before);
+	user_assert(used < WINDOW / 6);
+
+	// Blocking or yielding early never demotes an env.
+	user_assert(env->env_sched_level == 0);
+	for (i = 0; i < NGAMERS; i++) {
+		user_assert(envs[ENVX(gamers[i])].env_sched_level == 0);
+	}
+
+	done[0] = 1;
+	user_assert(wait(hogid) == 0);
+	for (i = 0; i < NGAMERS; i++) {
+		user_assert(wait(gamers[i]) == 0);
+	}
+	debugf("mlfq_check passed!\n");
+	return 0;
+}
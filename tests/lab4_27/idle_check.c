@@ -0,0 +1,40 @@
+// With no runnable env, the CPU idles until the next timer expires instead of panicking. Block
+// in 'ipc_recv' while the only other env sleeps: it must be woken up on time, and the idle period
+// must not be charged as CPU time to either env.
+
+#include <kclock.h>
+#include <lib.h>
+
+#define TICKS 20
+
+// Low 32 bits of the CPU time of 'envid', as 'top' reads them: enough for differences.
+static u_int cputime(u_int envid) {
+	return (u_int)envs[ENVX(envid)].env_utime + (u_int)envs[ENVX(envid)].env_ktime;
+}
+
+int main() {
+	u_int child, who, start, elapsed, busy;
+
+	if ((child = fork()) == 0) {
+		syscall_sleep(TICKS);
+		ipc_send(env->env_parent_id, TICKS, 0, 0);
+		exit(0);
+	}
+
+	start = syscall_clock();
+	busy = cputime(env->env_id) + cputime(child);
+	user_assert(ipc_recv(&who, 0, 0) == TICKS && who == child);
+	elapsed = syscall_clock() - start;
+	busy = cputime(env->env_id) + cputime(child) - busy;
+	debugf("idle_check: %u cycles elapsed, %u of them used by the envs\n", elapsed, busy);
+
+	// The sleeper is woken up by the tick its timer expires at, not several ticks later.
+	user_assert(elapsed >= (TICKS - 1) * TIMER_INTERVAL);
+	user_assert(elapsed <= (TICKS + 2) * TIMER_INTERVAL);
+	// Nearly all of that time was spent idle.
+	user_assert(busy < TIMER_INTERVAL);
+
+	user_assert(wait(child) == 0);
+	debugf("idle_check passed!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := idle_check/1
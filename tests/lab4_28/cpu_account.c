@@ -0,0 +1,71 @@
+// Per-env CPU time accounting: syscalls are counted one by one, a syscall-bound loop is charged
+// mostly as kernel time and a CPU-bound one as user time, all the time a spinner runs alone is
+// charged to it, and voluntary and involuntary switches are told apart.
+
+#include <kclock.h>
+#include <lib.h>
+
+#define NCALLS 200
+#define TICKS 20
+#define VA (UTEXT + PDMAP * 16)
+
+static volatile int done[1024] __attribute__((aligned(4096)));
+
+static void spin(void) {
+	while (!done[0]) {
+	}
+	exit(0);
+}
+
+int main() {
+	const volatile struct Env *s;
+	u_int i, syscalls, utime, ktime, nvcsw, nivcsw, start, elapsed, spinner;
+
+	// Share 'done' with the spinner, so that it can be stopped.
+	panic_on(syscall_mem_alloc(0, (void *)done, PTE_D | PTE_LIBRARY));
+
+	// Each syscall is counted, and a loop of syscalls is mostly kernel time.
+	syscalls = env->env_syscalls;
+	utime = (u_int)env->env_utime;
+	ktime = (u_int)env->env_ktime;
+	for (i = 0; i < NCALLS; i++) {
+		panic_on(syscall_mem_alloc(0, (void *)VA, PTE_D));
+		panic_on(syscall_mem_unmap(0, (void *)VA));
+	}
+	user_assert(env->env_syscalls - syscalls == 2 * NCALLS);
+	utime = (u_int)env->env_utime - utime;
+	ktime = (u_int)env->env_ktime - ktime;
+	debugf("cpu_account: %d syscalls: %u cycles in user mode, %u in the kernel\n",
+	       2 * NCALLS, utime, ktime);
+	user_assert(ktime > utime);
+
+	// While we sleep the spinner runs alone: all of that time is charged to it, as user time.
+	if ((spinner = fork()) == 0) {
+		spin();
+	}
+	s = &envs[ENVX(spinner)];
+	syscall_sleep(1);
+	nvcsw = env->env_nvcsw;
+	nivcsw = s->env_nivcsw;
+	utime = (u_int)s->env_utime;
+	ktime = (u_int)s->env_ktime;
+	start = syscall_clock();
+	syscall_sleep(TICKS);
+	elapsed = syscall_clock() - start;
+	utime = (u_int)s->env_utime - utime;
+	ktime = (u_int)s->env_ktime - ktime;
+	debugf("cpu_account: spinner: %u cycles in user mode, %u in the kernel, of %u\n", utime,
+	       ktime, elapsed);
+	user_assert(utime + ktime <= elapsed);
+	user_assert(utime + ktime >= elapsed - 2 * TIMER_INTERVAL);
+	user_assert(ktime < utime / 4);
+
+	// We gave up the CPU by sleeping, and the spinner was preempted to run us again.
+	user_assert(env->env_nvcsw > nvcsw);
+	user_assert(s->env_nivcsw > nivcsw);
+
+	done[0] = 1;
+	user_assert(wait(spinner) == 0);
+	debugf("cpu_account passed!\n");
+	return 0;
+}
@@ -0,0 +1 @@
+init-envs := cpu_account/1
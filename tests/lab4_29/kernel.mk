@@ -0,0 +1,2 @@
+init-envs := stride_share/1
+sched := stride
@@ -0,0 +1,60 @@
+// Check the stride policy: two CPU-bound envs of weights 1 and 3 share the CPU in proportion to
+// their weights. 'kernel.mk' builds the kernel with 'sched=stride'.
+
+#include <lib.h>
+#include <sched.h>
+
+#if MOS_SCHED_POLICY != SCHED_STRIDE
+#error "stride_share needs the stride policy (sched=stride)"
+#endif
+
+#define TICKS 100
+
+static volatile int done[1024] __attribute__((aligned(4096)));
+
+static void spin(void) {
+	while (!done[0]) {
+	}
+	exit(0);
+}
+
+// Low 32 bits of the CPU time of 'envid', as 'top' reads them: enough for differences.
+static u_int cputime(u_int envid) {
+	return (u_int)envs[ENVX(envid)].env_utime + (u_int)envs[ENVX(envid)].env_ktime;
+}
+
+int main() {
+	u_int light, heavy, l, h;
+
+	// Share 'done' with all children, so that they can be stopped.
+	panic_on(syscall_mem_alloc(0, (void *)done, PTE_D | PTE_LIBRARY));
+
+	if ((light = fork()) == 0) {
+		spin();
+	}
+	if ((heavy = fork()) == 0) {
+		spin();
+	}
+	// Children inherit our weight, and only a parent may change it.
+	user_assert(envs[ENVX(heavy)].env_pri == env->env_pri);
+	user_assert(syscall_set_sched_param(heavy, 0) == -E_INVAL);
+	user_assert(syscall_set_sched_param(heavy, SCHED_MAX_WEIGHT + 1) == -E_INVAL);
+	user_assert(syscall_set_sched_param(0, SCHED_MAX_WEIGHT) == -E_BAD_ENV);
+	panic_on(syscall_set_sched_param(light, 1));
+	panic_on(syscall_set_sched_param(heavy, 3));
+
+	syscall_sleep(1);
+	l = cputime(light);
+	h = cputime(heavy);
+	syscall_sleep(TICKS);
+	l = cputime(light) - l;
+	h = cputime(heavy) - h;
+	debugf("stride_share: weight 1: %u cycles, weight 3: %u cycles\n", l, h);
+	user_assert(h >= 2 * l && h <= 4 * l);
+
+	done[0] = 1;
+	user_assert(wait(light) == 0);
+	user_assert(wait(heavy) == 0);
+	debugf("stride_share passed!\n");
+	return 0;
+}
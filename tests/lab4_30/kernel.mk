@@ -0,0 +1,2 @@
+init-envs := slice_intr/1
+sched := mlfq
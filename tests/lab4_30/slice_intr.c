@@ -0,0 +1,51 @@
+// Count the timer interrupts taken by a CPU hog running alone. With round-robin the timer fires on
+// every tick. With the adaptive time slices of the MLFQ and stride policies, the slice of the hog
+// grows to 'SCHED_QUANTUM_MIN << SCHED_QUANTUM_MAX_ORDER' cycles, so it takes far fewer, while
+// an env that blocks early gets the shortest slice. 'kernel.mk' builds the kernel with
+// 'sched=mlfq'; build with 'sched=rr' or 'sched=stride' to compare.
+
+#include <lib.h>
+#include <sched.h>
+
+#define TICKS 64
+
+static volatile int done[1024] __attribute__((aligned(4096)));
+
+static void hog(void) {
+	while (!done[0]) {
+	}
+	exit(0);
+}
+
+int main() {
+	const volatile struct Env *h;
+	u_int hogid, nintr;
+
+	// Share 'done' with the hog, so that it can be stopped.
+	panic_on(syscall_mem_alloc(0, (void *)done, PTE_D | PTE_LIBRARY));
+
+	if ((hogid = fork()) == 0) {
+		hog();
+	}
+	h = &envs[ENVX(hogid)];
+	// Let the time slice of the hog grow to its longest.
+	syscall_sleep(16);
+
+	nintr = h->env_nintr;
+	syscall_sleep(TICKS);
+	nintr = h->env_nintr - nintr;
+	debugf("slice_intr: %u timer interrupts in %u ticks\n", nintr, TICKS);
+
+#if MOS_SCHED_POLICY == SCHED_RR
+	user_assert(nintr >= TICKS - 2);
+#else
+	user_assert(nintr <= TICKS / 4);
+	user_assert(h->env_quantum_order == SCHED_QUANTUM_MAX_ORDER);
+	user_assert(env->env_quantum_order == 0);
+#endif
+
+	done[0] = 1;
+	user_assert(wait(hogid) == 0);
+	debugf("slice_intr passed!\n");
+	return 0;
+}
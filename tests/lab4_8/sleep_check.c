@@ -0,0 +1,38 @@
+// Check 'syscall_sleep' and the timeout of 'ipc_recv_timed'.
+
+#include <kclock.h>
+#include <lib.h>
+
+int main() {
+	u_int start, elapsed, who, val;
+	int child, r;
+
+	// A sleep lasts at least 'ticks - 1' full timer ticks.
+	start = syscall_clock();
+	syscall_sleep(5);
+	elapsed = syscall_clock() - start;
+	debugf("slept %u cycles\n", elapsed);
+	user_assert(elapsed >= 4 * TIMER_INTERVAL);
+
+	if ((child = fork()) == 0) {
+		syscall_sleep(10);
+		ipc_send(env->env_parent_id, 2025, 0, 0);
+		return 0;
+	}
+
+	// Nobody sends to us within 3 ticks.
+	start = syscall_clock();
+	r = ipc_recv_timed(&who, &val, 0, 0, 3);
+	elapsed = syscall_clock() - start;
+	user_assert(r == -E_TIMEOUT);
+	user_assert(elapsed >= 2 * TIMER_INTERVAL);
+	user_assert(ipc_recv_timed(&who, &val, 0, 0, 0) == -E_TIMEOUT);
+
+	// The child sends within 100 ticks.
+	r = ipc_recv_timed(&who, &val, 0, 0, 100);
+	user_assert(r == 0 && who == child && val == 2025);
+
+	wait(child);
+	debugf("sleep_check passed!\n");
+	return 0;
+}
@@ -0,0 +1,86 @@
+// Ping-pong benchmark: measure the cost of an IPC round trip while other envs compete for the
+// CPU. Without a direct handoff from sender to receiver, each message waits for a full rotation
+// of the run queue.
+//
+// The round trip is measured twice: with separate send and receive syscalls on both sides, and
+// with 'ipc_call' / 'ipc_reply_wait', which take one syscall per side.
+
+#include <lib.h>
+
+#define NSPINNERS 3
+#define ROUNDS 200
+
+static volatile int done[1024] __attribute__((aligned(4096)));
+
+static void spin(void) {
+	while (!done[0]) {
+	}
+	exit(0);
+}
+
+int main() {
+	u_int who, i, start, cycles;
+	int spinners[NSPINNERS], partner, server, n, r;
+
+	// Share 'done' with all children, so that they can be stopped.
+	panic_on(syscall_mem_alloc(0, (void *)done, PTE_D | PTE_LIBRARY));
+
+	for (n = 0; n < NSPINNERS; n++) {
+		if ((spinners[n] = fork()) == 0) {
+			spin();
+		}
+	}
+
+	if ((partner = fork()) == 0) {
+		for (;;) {
+			i = ipc_recv(&who, 0, 0);
+			ipc_send(who, i + 1, 0, 0);
+			if (i + 1 >= ROUNDS) {
+				return 0;
+			}
+		}
+	}
+
+	i = 0;
+	start = syscall_clock();
+	while (i < ROUNDS) {
+		ipc_send(partner, i, 0, 0);
+		i = ipc_recv(&who, 0, 0);
+		user_assert(who == partner);
+	}
+	cycles = syscall_clock() - start;
+	debugf("ipc_bench: %d round trips with %d busy envs: %u cycles per round trip\n", ROUNDS,
+	       NSPINNERS, cycles / ROUNDS);
+
+	if ((server = fork()) == 0) {
+		i = ipc_reply_wait(0, 0, 0, 0, 0, &who, 0, 0);
+		while (i + 1 < ROUNDS) {
+			i = ipc_reply_wait(who, i + 1, 0, 0, 0, &who, 0, 0);
+		}
+		ipc_send(who, i + 1, 0, 0);
+		return 0;
+	}
+
+	i = 0;
+	start = syscall_clock();
+	while (i < ROUNDS) {
+		// The exit status of 'partner' may be queued meanwhile: only the reply is received.
+		i = ipc_call(server, i, 0, 0, 0, 0, 0);
+	}
+	cycles = syscall_clock() - start;
+	debugf("ipc_bench: %d calls with %d busy envs: %u cycles per round trip\n", ROUNDS,
+	       NSPINNERS, cycles / ROUNDS);
+
+	// Directed yield: give our slice to the partner, which has exited or is about to.
+	r = syscall_yield_to(partner);
+	user_assert(r == 0 || r == -E_BAD_ENV);
+
+	done[0] = 1;
+	wait(partner);
+	wait(server);
+	for (n = 0; n < NSPINNERS; n++) {
+		wait(spinners[n]);
+	}
+	debugf("ipc_bench passed!\n");
+	return 0;
+}
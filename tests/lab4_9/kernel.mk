@@ -0,0 +1 @@
+init-envs := ipc_bench/1
@@ -1,2 +1,2 @@
-init-envs += /user_icode /fs_serv
+init-envs += /user_icode /fs_serv/8
 fs-files  += $(wildcard $(test_dir)/fs/*)
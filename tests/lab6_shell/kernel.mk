@@ -1,3 +1,3 @@
 fs-files 	+= $(wildcard $(test_dir)/rootfs/*)
-init-envs += /user_icode /fs_serv
+init-envs += /user_icode /fs_serv/8
 
@@ -18,6 +18,11 @@ enum {
 	MAX_FSREQNO,
 };
 
+// Requests small enough to travel in IPC message words (see 'struct Ipc_msg') instead of a page.
+#define FSREQ_WORDS                                                                                \
+	((1 << FSREQ_MAP) | (1 << FSREQ_SET_SIZE) | (1 << FSREQ_CLOSE) | (1 << FSREQ_DIRTY) |      \
+	 (1 << FSREQ_SYNC))
+
 struct Fsreq_open {
 	char req_path[MAXPATHLEN];
 	u_int req_omode;
@@ -26,6 +31,7 @@ struct Fsreq_open {
 struct Fsreq_map {
 	int req_fileid;
 	u_int req_offset;
+	u_int req_nblocks; // number of blocks to map from 'req_offset' on, at most 'IPC_MAX_PAGES'
 };
 
 struct Fsreq_set_size {
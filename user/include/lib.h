@@ -15,9 +15,15 @@
 
 // libos
 void exit(int status) __attribute__((noreturn));
+void backoff(u_int *spins);
 
 extern const volatile struct Env *env;
 
+// Notification bits used by the library (see 'syscall_notify'), in 'NOTIFY_ANY'. Programs may use
+// the other bits, which an env may only post to itself or its children.
+#define NOTIFY_PIPE (1u << 31) // the other end of a pipe we wait on made progress
+#define NOTIFY_CHAN (1u << 30) // the other end of a channel we wait on made progress
+
 #define USED(x) (void)(x)
 
 // debugf
@@ -42,6 +48,7 @@ void _user_halt(const char *, int, const char *, ...) __attribute__((noreturn));
 int spawn(char *prog, char **argv);
 int spawnl(char *prot, char *args, ...);
 int fork(void);
+int user_fork(void);
 
 /// syscalls
 extern int msyscall(int, ...);
@@ -76,10 +83,73 @@ int syscall_get_var(const char *name, char *value, int bufsize);
 int syscall_get_all_var(char *buf, int bufsize);
 int syscall_alloc_shell_id(void);
 int syscall_get_parent_id(u_int);
+int syscall_sleep(u_int ticks);
+int syscall_ipc_recv_timed(void *dstva, u_int ticks);
+u_int syscall_clock(void);
+int syscall_set_sched_param(u_int envid, u_int weight);
+int syscall_yield_to(u_int envid);
+int syscall_ipc_send(u_int envid, u_int value, const void *srcva, u_int perm,
+		     const struct Ipc_msg *msg);
+int syscall_ipc_call(u_int envid, u_int value, const void *srcva, u_int perm, void *dstva,
+		     const struct Ipc_msg *msg);
+int syscall_ipc_reply_wait(u_int envid, u_int value, const void *srcva, u_int perm, void *dstva,
+			   const struct Ipc_msg *msg);
+int syscall_notify(u_int envid, u_int bits);
+u_int syscall_notify_wait(u_int mask, u_int ticks);
+int syscall_chan_create(u_int peer, u_int npages, void *va);
+int syscall_chan_attach(int chanid, void *va);
+int syscall_chan_signal(int chanid, u_int bits);
+int syscall_chan_detach(int chanid);
+int syscall_ipc_sendv(u_int envid, u_int value, const struct Ipc_page *iov, u_int npages,
+		      const struct Ipc_msg *msg);
+int syscall_ipc_recvv(void *dstva, u_int dstpages);
+int syscall_ipc_callv(u_int envid, u_int value, const struct Ipc_msg *msg, void *dstva,
+		      u_int dstpages);
+int syscall_ipc_replyv_wait(u_int envid, u_int value, const struct Ipc_page *iov, u_int npages,
+			    void *dstva);
+int syscall_submit(struct Sqe *sqes, u_int n);
+int syscall_mem_alloc_range(u_int envid, void *va, u_int npages, u_int perm);
+int syscall_mem_map_range(u_int dstid, void *srcva, void *dstva, u_int npages, u_int flags);
+int syscall_mem_unmap_range(u_int envid, void *va, u_int npages);
+int syscall_fork(void);
 
 // ipc.c
 void ipc_send(u_int whom, u_int val, const void *srcva, u_int perm);
 u_int ipc_recv(u_int *whom, void *dstva, u_int *perm);
+int ipc_recv_timed(u_int *whom, u_int *val, void *dstva, u_int *perm, u_int ticks);
+int ipc_call(u_int whom, u_int val, const void *srcva, u_int perm, const struct Ipc_msg *msg,
+	     void *dstva, u_int *rperm);
+u_int ipc_reply_wait(u_int whom, u_int val, const void *srcva, u_int perm,
+		     const struct Ipc_msg *msg, u_int *from, void *dstva, u_int *rperm);
+int ipc_callv(u_int whom, u_int val, const struct Ipc_msg *msg, void *dstva, u_int dstpages,
+	      u_int *npages);
+u_int ipc_replyv_wait(u_int whom, u_int val, const struct Ipc_page *iov, u_int npages,
+		      u_int *from, void *dstva, u_int *rperm);
+
+// chan.c
+// Channels are mapped in slots of 'CHAN_MAX_PAGES' pages in the 4MB below 'FDTABLE'.
+#define CHANBASE (FDTABLE - PDMAP)
+
+struct Chan {
+	int c_id;		  // channel id, see 'syscall_chan_create'
+	u_int c_npages;		  // pages mapped at 'c_ring'
+	u_int c_size;		  // bytes in the data ring
+	struct Chan_ring *c_ring; // shared ring header, followed by the data
+};
+
+int chan_create(u_int peer, u_int npages, struct Chan *c);
+int chan_attach(int chanid, struct Chan *c);
+int chan_send(struct Chan *c, const void *buf, u_int n);
+int chan_recv(struct Chan *c, void *buf, u_int n);
+void chan_close(struct Chan *c);
+
+// submit.c
+// Each env queues its batches of syscalls in a private page ('PTE_PRIVATE'), which 'fork' does
+// not copy.
+#define SUBMITVA (CHANBASE - PAGE_SIZE)
+
+int submit_add(u_int sysno, u_int a1, u_int a2, u_int a3, u_int a4, u_int a5);
+int submit_flush(void);
 
 // wait.c
 int wait(u_int envid);
@@ -102,6 +172,7 @@ int printf(const char *fmt, ...);
 // fsipc.c
 int fsipc_open(const char *, u_int, struct Fd *);
 int fsipc_map(u_int, u_int, void *);
+int fsipc_mapv(u_int, u_int, u_int, void *);
 int fsipc_set_size(u_int, u_int);
 int fsipc_close(u_int);
 int fsipc_dirty(u_int, u_int);
@@ -0,0 +1,218 @@
+#include <chan.h>
+#include <env.h>
+#include <lib.h>
+#include <mmu.h>
+
+/*
+ * A channel (see 'kern/chan.c') is used as a single-producer, single-consumer byte ring: the
+ * creator sends and the peer receives. The producer only writes 'r_head' and the consumer only
+ * 'r_tail', so no lock is needed. Data moves through the shared pages without syscalls; the
+ * doorbell ('syscall_chan_signal') is only rung when the other end is blocked waiting.
+ */
+
+// A blocked end re-checks the ring at least this often, in case the other end went away without
+// closing the channel (e.g. it was destroyed).
+#define CHAN_WAIT_TICKS 10
+
+// 'r_head' and 'r_tail' start just below 2^32, so that every channel crosses the wrap of the
+// counters early instead of only after 4GB.
+#define CHAN_START ((u_int)-65536)
+
+// Header at the start of the first page of a channel, followed by the data ring.
+struct Chan_ring {
+	u_int r_envs[2];	    // envids of the producer and the consumer
+	volatile u_int r_head;	    // 'CHAN_START' + bytes written so far (by the producer)
+	volatile u_int r_tail;	    // 'CHAN_START' + bytes read so far (by the consumer)
+	volatile u_int r_rwaiting;  // the consumer waits for data
+	volatile u_int r_wwaiting;  // the producer waits for room
+	volatile u_int r_closed;    // an end has closed the channel
+	u_char r_data[];
+};
+
+/* Overview:
+ *   Find a free slot of 'CHAN_MAX_PAGES' pages in the channel region of our address space.
+ *
+ * Post-Condition:
+ *   Return the address of the slot, or 0 if all slots are in use.
+ */
+static u_int chan_slot(void) {
+	u_int va;
+
+	for (va = CHANBASE; va < CHANBASE + PDMAP; va += CHAN_MAX_PAGES * PAGE_SIZE) {
+		if (!(vpd[PDX(va)] & PTE_V) || !(vpt[VPN(va)] & PTE_V)) {
+			return va;
+		}
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Set up 'c' for channel 'chanid' of 'npages' pages mapped at 'va'.
+ *
+ * Post-Condition:
+ *   'c->c_size' is the largest power of two that fits after the ring header, so that offsets
+ *   into the ring are 'r_head' and 'r_tail' masked with 'c_size - 1', which stays right when the
+ *   counters wrap.
+ */
+static void chan_setup(struct Chan *c, int chanid, u_int va, u_int npages) {
+	u_int room = npages * PAGE_SIZE - sizeof(struct Chan_ring);
+
+	c->c_id = chanid;
+	c->c_ring = (struct Chan_ring *)va;
+	c->c_npages = npages;
+	for (c->c_size = PAGE_SIZE / 2; c->c_size * 2 <= room; c->c_size *= 2) {
+	}
+}
+
+/* Overview:
+ *   Create a channel of 'npages' pages to send data to 'peer', and set up 'c' as its sending end.
+ *   'peer' sets up the receiving end with 'chan_attach', given the channel id 'c->c_id'.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or an error code from 'syscall_chan_create' (-E_NO_MEM if no slot is
+ *   left in our channel region).
+ */
+int chan_create(u_int peer, u_int npages, struct Chan *c) {
+	u_int va;
+	int r;
+
+	if ((va = chan_slot()) == 0) {
+		return -E_NO_MEM;
+	}
+	if ((r = syscall_chan_create(peer, npages, (void *)va)) < 0) {
+		return r;
+	}
+	chan_setup(c, r, va, npages);
+	c->c_ring->r_envs[0] = env->env_id;
+	c->c_ring->r_envs[1] = peer;
+	c->c_ring->r_head = c->c_ring->r_tail = CHAN_START;
+	return 0;
+}
+
+/* Overview:
+ *   Set up 'c' as the receiving end of channel 'chanid', created for us by its sender.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or an error code from 'syscall_chan_attach'.
+ */
+int chan_attach(int chanid, struct Chan *c) {
+	u_int va;
+	int r;
+
+	if ((va = chan_slot()) == 0) {
+		return -E_NO_MEM;
+	}
+	if ((r = syscall_chan_attach(chanid, (void *)va)) < 0) {
+		return r;
+	}
+	chan_setup(c, chanid, va, r);
+	return 0;
+}
+
+/* Overview:
+ *   Return non-zero if the other end of 'c' ('end' is its index in 'r_envs') has closed the
+ *   channel or is gone.
+ */
+static int chan_is_closed(struct Chan *c, int end) {
+	u_int envid = c->c_ring->r_envs[end];
+	const volatile struct Env *e = &envs[ENVX(envid)];
+
+	return c->c_ring->r_closed || e->env_id != envid || e->env_status == ENV_FREE;
+}
+
+/* Overview:
+ *   Block until the other end rings the doorbell, unless 'cond' no longer holds once 'waiting'
+ *   is set.
+ */
+#define chan_wait(waiting, cond)                                                                   \
+	do {                                                                                       \
+		*(waiting) = 1;                                                                    \
+		if (cond) {                                                                        \
+			syscall_notify_wait(NOTIFY_CHAN, CHAN_WAIT_TICKS);                         \
+		}                                                                                  \
+		*(waiting) = 0;                                                                    \
+	} while (0)
+
+/* Overview:
+ *   Ring the doorbell of 'c' if the other end waits on 'waiting'.
+ */
+static void chan_kick(struct Chan *c, volatile u_int *waiting) {
+	if (*waiting) {
+		*waiting = 0;
+		syscall_chan_signal(c->c_id, NOTIFY_CHAN);
+	}
+}
+
+/* Overview:
+ *   Send the 'n' bytes at 'buf' over 'c', blocking while the ring is full.
+ *
+ * Post-Condition:
+ *   Return 'n', or the number of bytes sent before the receiving end closed the channel.
+ */
+int chan_send(struct Chan *c, const void *buf, u_int n) {
+	struct Chan_ring *r = c->c_ring;
+	u_int done = 0, len, off, first;
+
+	while (done < n) {
+		while (r->r_head - r->r_tail == c->c_size) {
+			if (chan_is_closed(c, 1)) {
+				return done;
+			}
+			chan_wait(&r->r_wwaiting, r->r_head - r->r_tail == c->c_size);
+		}
+		len = MIN(n - done, c->c_size - (r->r_head - r->r_tail));
+		off = r->r_head & (c->c_size - 1);
+		first = MIN(len, c->c_size - off);
+		memcpy(r->r_data + off, (const u_char *)buf + done, first);
+		memcpy(r->r_data, (const u_char *)buf + done + first, len - first);
+		r->r_head += len;
+		done += len;
+		chan_kick(c, &r->r_rwaiting);
+	}
+	return done;
+}
+
+/* Overview:
+ *   Receive at most 'n' bytes from 'c' into 'buf', blocking while the ring is empty.
+ *
+ * Post-Condition:
+ *   Return the number of bytes received, which is greater than 0 unless the sending end has
+ *   closed the channel and everything sent has been received.
+ */
+int chan_recv(struct Chan *c, void *buf, u_int n) {
+	struct Chan_ring *r = c->c_ring;
+	u_int len, off, first;
+
+	while (r->r_head == r->r_tail) {
+		if (chan_is_closed(c, 0)) {
+			// Data may have been sent just before closing.
+			if (r->r_head == r->r_tail) {
+				return 0;
+			}
+			break;
+		}
+		chan_wait(&r->r_rwaiting, r->r_head == r->r_tail);
+	}
+	len = MIN(n, r->r_head - r->r_tail);
+	off = r->r_tail & (c->c_size - 1);
+	first = MIN(len, c->c_size - off);
+	memcpy(buf, r->r_data + off, first);
+	memcpy((u_char *)buf + first, r->r_data, len - first);
+	r->r_tail += len;
+	chan_kick(c, &r->r_wwaiting);
+	return len;
+}
+
+/* Overview:
+ *   Close our end of 'c', waking up the other end, and unmap the channel.
+ */
+void chan_close(struct Chan *c) {
+	struct Chan_ring *r = c->c_ring;
+
+	r->r_closed = 1;
+	if (r->r_rwaiting || r->r_wwaiting) {
+		syscall_chan_signal(c->c_id, NOTIFY_CHAN);
+	}
+	syscall_chan_detach(c->c_id);
+	syscall_mem_unmap_range(0, r, c->c_npages);
+}
@@ -123,12 +123,11 @@ void close_all(void) {
  * Hint:
  *   Use 'fd_lookup' or 'INDEX2FD' to get 'fd' to 'fdnum'.
  *   Use 'fd2data' to get the data address to 'fd'.
- *   Use 'syscall_mem_map' to share the data pages.
+ *   Use 'syscall_mem_map_range' to share the data pages.
  */
 int dup(int oldfdnum, int newfdnum) {
-	int i, r;
+	int r;
 	void *ova, *nva;
-	u_int pte;
 	struct Fd *oldfd, *newfd;
 
 	/* Step 1: Check if 'oldnum' is valid. if not, return an error code, or get 'fd'. */
@@ -145,17 +144,11 @@ int dup(int oldfdnum, int newfdnum) {
 	nva = fd2data(newfd);
 	/* Step 5: Dunplicate the data and 'fd' self from old to new. */
 
+	// The data pages of an fd (file blocks, pipe buffers) are shared with 'PTE_LIBRARY'. Only
+	// those are duplicated, as they are mapped, never a private or copy-on-write page.
 	if (vpd[PDX(ova)]) {
-		for (i = 0; i < PDMAP; i += PTMAP) {
-			pte = vpt[VPN(ova + i)];
-
-			if (pte & PTE_V) {
-				// should be no error here -- pd is already allocated
-				if ((r = syscall_mem_map(0, (void *)(ova + i), 0, (void *)(nva + i),
-							 pte & (PTE_D | PTE_LIBRARY))) < 0) {
-					goto err;
-				}
-			}
+		if ((r = syscall_mem_map_range(0, ova, nva, PDMAP / PTMAP, MAP_LIBRARY)) < 0) {
+			goto err;
 		}
 	}
 
@@ -168,10 +161,7 @@ int dup(int oldfdnum, int newfdnum) {
 err:
 	/* If error occurs, cancel all map operations. */
 	panic_on(syscall_mem_unmap(0, newfd));
-
-	for (i = 0; i < PDMAP; i += PTMAP) {
-		panic_on(syscall_mem_unmap(0, (void *)(nva + i)));
-	}
+	panic_on(syscall_mem_unmap_range(0, nva, PDMAP / PTMAP));
 
 	return r;
 }
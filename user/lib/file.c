@@ -53,16 +53,17 @@ int open(const char *path, int mode) {
 	// 'fd2data'. Set 'size' and 'fileid' correctly with the value in 'fd' as a 'Filefd'.
 	char *va;
 	struct Filefd *ffd;
-	u_int size, fileid;
+	u_int size, fileid, n;
 	/* Exercise 5.9: Your code here. (3/5) */
 	va = fd2data(fd);
 	ffd = (struct Filefd *)fd;
 	size = ffd->f_file.f_size;
 	fileid = ffd->f_fileid;
-	// Step 4: Map the file content using 'fsipc_map'.
-	for (int i = 0; i < size; i += PTMAP) {
+	// Step 4: Map the file content using 'fsipc_mapv', up to 'IPC_MAX_PAGES' blocks at a time.
+	for (int i = 0; i < size; i += n * PTMAP) {
 		/* Exercise 5.9: Your code here. (4/5) */
-		if ((r = fsipc_map(fileid, i, va + i)) != 0) {
+		n = MIN(ROUND(size - i, PTMAP) / PTMAP, IPC_MAX_PAGES);
+		if ((r = fsipc_mapv(fileid, i, n, va + i)) != 0) {
 			return r;
 		}
 	}
@@ -106,11 +107,9 @@ int file_close(struct Fd *fd) {
 	if (size == 0) {
 		return 0;
 	}
-	for (i = 0; i < size; i += PTMAP) {
-		if ((r = syscall_mem_unmap(0, (void *)(va + i))) < 0) {
-			debugf("cannont unmap the file\n");
-			return r;
-		}
+	if ((r = syscall_mem_unmap_range(0, va, ROUND(size, PTMAP) / PTMAP)) < 0) {
+		debugf("cannont unmap the file\n");
+		return r;
 	}
 	return 0;
 }
@@ -213,7 +212,7 @@ int ftruncate(int fdnum, u_int size) {
 	int i, r;
 	struct Fd *fd;
 	struct Filefd *f;
-	u_int oldsize, fileid;
+	u_int oldsize, fileid, n;
 
 	if (size > MAXFILESIZE) {
 		return -E_NO_DISK;
@@ -238,9 +237,10 @@ int ftruncate(int fdnum, u_int size) {
 
 	void *va = fd2data(fd);
 
-	// Map any new pages needed if extending the file
-	for (i = ROUND(oldsize, PTMAP); i < ROUND(size, PTMAP); i += PTMAP) {
-		if ((r = fsipc_map(fileid, i, va + i)) < 0) {
+	// Map any new pages needed if extending the file, up to 'IPC_MAX_PAGES' at a time
+	for (i = ROUND(oldsize, PTMAP); i < ROUND(size, PTMAP); i += n * PTMAP) {
+		n = MIN((ROUND(size, PTMAP) - i) / PTMAP, IPC_MAX_PAGES);
+		if ((r = fsipc_mapv(fileid, i, n, va + i)) < 0) {
 			int _r = fsipc_set_size(fileid, oldsize);
 			if (_r < 0) {
 				return _r;
@@ -250,9 +250,11 @@ int ftruncate(int fdnum, u_int size) {
 	}
 
 	// Unmap pages if truncating the file
-	for (i = ROUND(size, PTMAP); i < ROUND(oldsize, PTMAP); i += PTMAP) {
-		if ((r = syscall_mem_unmap(0, (void *)(va + i))) < 0) {
-			user_panic("ftruncate: syscall_mem_unmap %08x: %d\n", va + i, r);
+	if (size < oldsize) {
+		i = ROUND(size, PTMAP);
+		n = (ROUND(oldsize, PTMAP) - i) / PTMAP;
+		if ((r = syscall_mem_unmap_range(0, va + i, n)) < 0) {
+			user_panic("ftruncate: syscall_mem_unmap_range %08x: %d\n", va + i, r);
 		}
 	}
 
@@ -4,6 +4,8 @@
 
 /* Overview:
  *   Map the faulting page to a private writable copy.
+ *   The kernel resolves copy-on-write faults itself (see 'do_tlb_mod'): this is only reached for
+ *   writes to other read-only pages, which it reports.
  *
  * Pre-Condition:
  * 	'va' is the address which led to the TLB Mod exception.
@@ -47,50 +49,23 @@ static void __attribute__((noreturn)) cow_entry(struct Trapframe *tf) {
 }
 
 /* Overview:
- *   Grant our child 'envid' access to the virtual page 'vpn' (with address 'vpn' * 'PAGE_SIZE') in
- * our (current env's) address space. 'PTE_COW' should be used to isolate the modifications on
+ *   Grant our child 'envid' access to the pages mapped in [start, end) of our (current env's)
+ * address space, at the same addresses. 'PTE_COW' should be used to isolate the modifications on
  * unshared memory from a parent and its children.
  *
  * Post-Condition:
- *   If the virtual page 'vpn' has 'PTE_D' and doesn't has 'PTE_LIBRARY', both our original virtual
- *   page and 'envid''s newly-mapped virtual page should be marked 'PTE_COW' and without 'PTE_D',
- *   while the other permission bits are kept.
- *
- *   If not, the newly-mapped virtual page in 'envid' should have the exact same permission as our
- *   original virtual page.
+ *   Each page with 'PTE_D' and without 'PTE_LIBRARY' is marked 'PTE_COW' and without 'PTE_D', both
+ *   in our address space and in 'envid''s, while the other permission bits are kept. The other
+ *   pages are mapped in 'envid' with the exact same permission as ours.
  *
  * Hint:
  *   - 'PTE_LIBRARY' indicates that the page should be shared among a parent and its children.
- *   - A page with 'PTE_LIBRARY' may have 'PTE_D' at the same time, you should handle it correctly.
- *   - You can pass '0' as an 'envid' in arguments of 'syscall_*' to indicate current env because
- *     kernel 'envid2env' converts '0' to 'curenv').
- *   - You should use 'syscall_mem_map', the user space wrapper around 'msyscall' to invoke
- *     'sys_mem_map' in kernel.
+ *   - 'sys_mem_map_range' with 'MAP_COW' does this for the whole range in one syscall, mapping
+ *     each page to the child before remapping it in the parent.
  */
-static void duppage(u_int envid, u_int vpn) {
-	u_int addr;
-	u_int perm;
-
-	/* Step 1: Get the permission of the page. */
-	/* Hint: Use 'vpt' to find the page table entry. */
-	/* Exercise 4.10: Your code here. (1/2) */
-	addr = vpn << PGSHIFT;
-	perm = vpt[vpn] & ((1 << PGSHIFT) - 1);
-	/* Step 2: If the page is writable, and not shared with children, and not marked as COW yet,
-	 * then map it as copy-on-write, both in the parent (0) and the child (envid). */
-	/* Hint: The page should be first mapped to the child before remapped in the parent. (Why?)
-	 */
-	/* Exercise 4.10: Your code here. (2/2) */
-	int flag = 0;
-	if ((perm & PTE_D) && !(perm & PTE_LIBRARY) && !(perm & PTE_COW)) {
-		perm = (perm & ~PTE_D) | PTE_COW;
-		flag = 1;
-	}
-	syscall_mem_map(0, (void *)addr, envid, (void *)addr, perm);
-	if (flag) {
-		syscall_mem_map(0, (void *)addr, 0, (void *)addr, perm);
-	}
-
+static int duprange(u_int envid, u_int start, u_int end) {
+	return syscall_mem_map_range(envid, (void *)start, (void *)start, VPN(end - start),
+				     MAP_COW);
 }
 
 /* Overview:
@@ -101,17 +76,19 @@ static void duppage(u_int envid, u_int vpn) {
  *   Child's 'env' is properly set.
  *
  * Hint:
- *   Use global symbols 'env', 'vpt' and 'vpd'.
- *   Use 'syscall_set_tlb_mod_entry', 'syscall_getenvid', 'syscall_exofork',  and 'duppage'.
+ *   Use global symbol 'env'.
+ *   Use 'syscall_set_tlb_mod_entry', 'syscall_getenvid', 'syscall_exofork',  and 'duprange'.
+ *   'fork' falls back to this when the kernel has no 'sys_fork'.
  */
-int fork(void) {
+int user_fork(void) {
 	u_int child;
-	u_int i;
 
 	/* Step 1: Set our TLB Mod user exception entry to 'cow_entry' if not done yet. */
 	if (env->env_user_tlb_mod_entry != (u_int)cow_entry) {
 		try(syscall_set_tlb_mod_entry(0, cow_entry));
 	}
+	// Run any syscalls still queued, so that the child starts with an empty queue.
+	try(submit_flush());
 
 	/* Step 2: Create a child env that's not ready to be scheduled. */
 	// Hint: 'env' should always point to the current env itself, so we should fix it to the
@@ -123,13 +100,10 @@ int fork(void) {
 	}
 
 	/* Step 3: Map all mapped pages below 'USTACKTOP' into the child's address space. */
-	// Hint: You should use 'duppage'.
+	// Hint: You should use 'duprange'.
 	/* Exercise 4.15: Your code here. (1/2) */
-	for (i = 0; i < VPN(USTACKTOP); i++) {
-		if ((vpd[i >> 10] & PTE_V) && (vpt[i] & PTE_V)) {
-			duppage(child, i);
-		}
-	}
+	// Our submission page (see 'submit_add') is private: the child gets its own.
+	try(duprange(child, UTEMP, USTACKTOP));
 	/* Step 4: Set up the child's tlb mod handler and set child's 'env_status' to
 	 * 'ENV_RUNNABLE'. */
 	/* Hint:
@@ -141,3 +115,29 @@ int fork(void) {
 	try(syscall_set_env_status(child, ENV_RUNNABLE));
 	return child;
 }
+
+/* Overview:
+ *   Create a child with a copy-on-write copy of our address space, as 'user_fork' does, but in a
+ *   single 'sys_fork'.
+ *
+ * Post-Conditon:
+ *   Return the child's envid, or 0 in the child, whose 'env' is properly set.
+ *   Return the original error if underlying calls fail.
+ */
+int fork(void) {
+	int child;
+
+	if (env->env_user_tlb_mod_entry != (u_int)cow_entry) {
+		try(syscall_set_tlb_mod_entry(0, cow_entry));
+	}
+	try(submit_flush());
+
+	child = syscall_fork();
+	if (child == -E_NO_SYS) {
+		return user_fork();
+	}
+	if (child == 0) {
+		env = envs + ENVX(syscall_getenvid());
+	}
+	return child;
+}
@@ -20,10 +20,19 @@ u_char fsipcbuf[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
 //  0 if successful,
 //  < 0 on failure.
 static int fsipc(u_int type, void *fsreq, void *dstva, u_int *perm) {
-	u_int whom;
 	// Our file system server must be the 2nd env.
-	ipc_send(envs[1].env_id, type, fsreq, PTE_D);
-	return ipc_recv(&whom, dstva, perm);
+	return ipc_call(envs[1].env_id, type, fsreq, PTE_D, 0, dstva, perm);
+}
+
+// Overview:
+//  Like 'fsipc', for the small requests in 'FSREQ_WORDS': the 'size' bytes at
+//  'fsreq' are sent in IPC message words, so no page is mapped into the server.
+static int fsipc_words(u_int type, const void *fsreq, u_int size, void *dstva, u_int *perm) {
+	struct Ipc_msg msg;
+
+	msg.len = ROUND(size, sizeof(u_int)) / sizeof(u_int);
+	memcpy(msg.words, fsreq, size);
+	return ipc_call(envs[1].env_id, type, 0, 0, &msg, dstva, perm);
 }
 
 // Overview:
@@ -60,13 +69,13 @@ int fsipc_open(const char *path, u_int omode, struct Fd *fd) {
 int fsipc_map(u_int fileid, u_int offset, void *dstva) {
 	int r;
 	u_int perm;
-	struct Fsreq_map *req;
+	struct Fsreq_map req;
 
-	req = (struct Fsreq_map *)fsipcbuf;
-	req->req_fileid = fileid;
-	req->req_offset = offset;
+	req.req_fileid = fileid;
+	req.req_offset = offset;
+	req.req_nblocks = 1;
 
-	if ((r = fsipc(FSREQ_MAP, req, dstva, &perm)) < 0) {
+	if ((r = fsipc_words(FSREQ_MAP, &req, sizeof(req), dstva, &perm)) < 0) {
 		return r;
 	}
 
@@ -77,36 +86,64 @@ int fsipc_map(u_int fileid, u_int offset, void *dstva) {
 	return 0;
 }
 
+// Overview:
+//  Like 'fsipc_map', but map the 'nblocks' consecutive blocks from 'offset' on
+//  (at most 'IPC_MAX_PAGES') at 'dstva' with a single request.
+//
+// Returns:
+//  0 on success,
+//  < 0 on failure.
+int fsipc_mapv(u_int fileid, u_int offset, u_int nblocks, void *dstva) {
+	int r;
+	u_int npages;
+	struct Fsreq_map req;
+	struct Ipc_msg msg;
+
+	req.req_fileid = fileid;
+	req.req_offset = offset;
+	req.req_nblocks = nblocks;
+	msg.len = sizeof(req) / sizeof(u_int);
+	memcpy(msg.words, &req, sizeof(req));
+
+	if ((r = ipc_callv(envs[1].env_id, FSREQ_MAP, &msg, dstva, nblocks, &npages)) < 0) {
+		return r;
+	}
+
+	if (npages != nblocks) {
+		user_panic("fsipc_mapv: got %d blocks instead of %d at dstva %08x", npages, nblocks,
+			   dstva);
+	}
+
+	return 0;
+}
+
 // Overview:
 //  Make a set-file-size request to the file server.
 int fsipc_set_size(u_int fileid, u_int size) {
-	struct Fsreq_set_size *req;
+	struct Fsreq_set_size req;
 
-	req = (struct Fsreq_set_size *)fsipcbuf;
-	req->req_fileid = fileid;
-	req->req_size = size;
-	return fsipc(FSREQ_SET_SIZE, req, 0, 0);
+	req.req_fileid = fileid;
+	req.req_size = size;
+	return fsipc_words(FSREQ_SET_SIZE, &req, sizeof(req), 0, 0);
 }
 
 // Overview:
 //  Make a file-close request to the file server. After this the fileid is invalid.
 int fsipc_close(u_int fileid) {
-	struct Fsreq_close *req;
+	struct Fsreq_close req;
 
-	req = (struct Fsreq_close *)fsipcbuf;
-	req->req_fileid = fileid;
-	return fsipc(FSREQ_CLOSE, req, 0, 0);
+	req.req_fileid = fileid;
+	return fsipc_words(FSREQ_CLOSE, &req, sizeof(req), 0, 0);
 }
 
 // Overview:
 //  Ask the file server to mark a particular file block dirty.
 int fsipc_dirty(u_int fileid, u_int offset) {
-	struct Fsreq_dirty *req;
+	struct Fsreq_dirty req;
 
-	req = (struct Fsreq_dirty *)fsipcbuf;
-	req->req_fileid = fileid;
-	req->req_offset = offset;
-	return fsipc(FSREQ_DIRTY, req, 0, 0);
+	req.req_fileid = fileid;
+	req.req_offset = offset;
+	return fsipc_words(FSREQ_DIRTY, &req, sizeof(req), 0, 0);
 }
 
 // Overview:
@@ -133,7 +170,7 @@ int fsipc_remove(const char *path) {
 //  Ask the file server to update the disk by writing any dirty
 //  blocks in the buffer cache.
 int fsipc_sync(void) {
-	return fsipc(FSREQ_SYNC, fsipcbuf, 0, 0);
+	return fsipc_words(FSREQ_SYNC, 0, 0, 0, 0);
 }
 
 int fsipc_create(const char* path, u_int type) {
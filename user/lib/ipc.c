@@ -4,16 +4,11 @@
 #include <lib.h>
 #include <mmu.h>
 
-// Send val to whom.  This function keeps trying until
-// it succeeds.  It should panic() on any error other than
-// -E_IPC_NOT_RECV.
-//
-// Hint: use syscall_yield() to be CPU-friendly.
+// Send val to whom.  If whom is not receiving yet, we block in the kernel
+// until it is (senders to the same env are served in FIFO order).
+// It should panic() on any error.
 void ipc_send(u_int whom, u_int val, const void *srcva, u_int perm) {
-	int r;
-	while ((r = syscall_ipc_try_send(whom, val, srcva, perm)) == -E_IPC_NOT_RECV) {
-		syscall_yield();
-	}
+	int r = syscall_ipc_send(whom, val, srcva, perm, 0);
 	user_assert(r == 0);
 }
 
@@ -37,3 +32,108 @@ u_int ipc_recv(u_int *whom, void *dstva, u_int *perm) {
 
 	return env->env_ipc_value;
 }
+
+// Like ipc_recv, but give up after 'ticks' timer ticks. The value received is stored in *val.
+// Return 0 on success, or -E_TIMEOUT if no message arrived in time.
+int ipc_recv_timed(u_int *whom, u_int *val, void *dstva, u_int *perm, u_int ticks) {
+	int r = syscall_ipc_recv_timed(dstva, ticks);
+	if (r == -E_TIMEOUT) {
+		return r;
+	}
+	if (r != 0) {
+		user_panic("syscall_ipc_recv_timed err: %d", r);
+	}
+
+	if (whom) {
+		*whom = env->env_ipc_from;
+	}
+
+	if (perm) {
+		*perm = env->env_ipc_perm;
+	}
+
+	if (val) {
+		*val = env->env_ipc_value;
+	}
+
+	return 0;
+}
+
+// Send val (and the words in msg, if not 0) to whom and wait for its reply, in
+// a single syscall.  Only a reply from whom is accepted: other messages sent to
+// us meanwhile stay queued.
+// Return the value of the reply, or an error if whom could not take the call,
+// and store the permissions of the page received at dstva in *rperm.  The words
+// of the reply are in env->env_ipc_msg.
+int ipc_call(u_int whom, u_int val, const void *srcva, u_int perm, const struct Ipc_msg *msg,
+	     void *dstva, u_int *rperm) {
+	int r = syscall_ipc_call(whom, val, srcva, perm, dstva, msg);
+	if (r != 0) {
+		return r;
+	}
+
+	if (rperm) {
+		*rperm = env->env_ipc_perm;
+	}
+
+	return env->env_ipc_value;
+}
+
+// Reply val (and the words in msg, if not 0) to the ipc_call of whom (unless
+// whom is 0), then receive the next message like ipc_recv, in a single syscall.
+// Store the sender of that message in *from.  Its words are in env->env_ipc_msg.
+u_int ipc_reply_wait(u_int whom, u_int val, const void *srcva, u_int perm,
+		     const struct Ipc_msg *msg, u_int *from, void *dstva, u_int *rperm) {
+	int r = syscall_ipc_reply_wait(whom, val, srcva, perm, dstva, msg);
+	if (r != 0) {
+		user_panic("syscall_ipc_reply_wait err: %d", r);
+	}
+
+	if (from) {
+		*from = env->env_ipc_from;
+	}
+
+	if (rperm) {
+		*rperm = env->env_ipc_perm;
+	}
+
+	return env->env_ipc_value;
+}
+
+// Like ipc_call with a request of message words only, but receive the reply in
+// a window of dstpages pages at dstva, where the server may map several pages
+// at once (see ipc_replyv_wait).  Store the number of pages received in
+// *npages.
+int ipc_callv(u_int whom, u_int val, const struct Ipc_msg *msg, void *dstva, u_int dstpages,
+	      u_int *npages) {
+	int r = syscall_ipc_callv(whom, val, msg, dstva, dstpages);
+	if (r != 0) {
+		return r;
+	}
+
+	if (npages) {
+		*npages = env->env_ipc_npages;
+	}
+
+	return env->env_ipc_value;
+}
+
+// Like ipc_reply_wait, but reply with the npages pages described in iov,
+// each mapped at its dstoff in the window of the ipc_callv of whom.
+u_int ipc_replyv_wait(u_int whom, u_int val, const struct Ipc_page *iov, u_int npages,
+		      u_int *from, void *dstva, u_int *rperm) {
+	int r = syscall_ipc_replyv_wait(whom, val, iov, npages, dstva);
+	if (r != 0) {
+		user_panic("syscall_ipc_replyv_wait err: %d", r);
+	}
+
+	if (from) {
+		*from = env->env_ipc_from;
+	}
+
+	if (rperm) {
+		*rperm = env->env_ipc_perm;
+	}
+
+	return env->env_ipc_value;
+}
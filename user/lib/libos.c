@@ -17,6 +17,18 @@ void exit(int status) {
 	user_panic("unreachable code");
 }
 
+// Polling loops call this once per failed poll: the first few rounds just yield, then each round
+// sleeps for a timer tick so that a long wait doesn't keep the CPU busy.
+#define BACKOFF_YIELDS 8
+
+void backoff(u_int *spins) {
+	if (++*spins <= BACKOFF_YIELDS) {
+		syscall_yield();
+	} else {
+		syscall_sleep(1);
+	}
+}
+
 const volatile struct Env *env;
 extern int main(int, char **);
 
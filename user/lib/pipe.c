@@ -19,10 +19,16 @@ struct Dev devpipe = {
 
 #define PIPE_SIZE 32 // small to provoke races
 
+// A blocked reader or writer re-checks the pipe at least this often, in case its peer went away
+// without waking it up (e.g. it was destroyed), or another env waits on the same end.
+#define PIPE_WAIT_TICKS 10
+
 struct Pipe {
 	u_int p_rpos;		 // read position
 	u_int p_wpos;		 // write position
 	u_char p_buf[PIPE_SIZE]; // data buffer
+	u_int p_rwaiter;	 // envid of a reader blocked on an empty pipe, or 0
+	u_int p_wwaiter;	 // envid of a writer blocked on a full pipe, or 0
 };
 
 /* Overview:
@@ -116,6 +122,31 @@ static int _pipe_is_closed(struct Fd *fd, struct Pipe *p) {
 	return fd_ref == pipe_ref;
 }
 
+/* Overview:
+ *   Block until woken up by 'pipe_wakeup' on 'waiter', unless 'cond' no longer holds once we are
+ *   registered in 'waiter'.
+ */
+#define pipe_wait(waiter, cond)                                                                    \
+	do {                                                                                       \
+		*(waiter) = env->env_id;                                                           \
+		if (cond) {                                                                        \
+			syscall_notify_wait(NOTIFY_PIPE, PIPE_WAIT_TICKS);                         \
+		}                                                                                  \
+		*(waiter) = 0;                                                                     \
+	} while (0)
+
+/* Overview:
+ *   Wake up the env blocked in 'pipe_wait' on 'waiter', if any.
+ */
+static void pipe_wakeup(u_int *waiter) {
+	u_int envid = *waiter;
+
+	if (envid != 0) {
+		*waiter = 0;
+		syscall_notify(envid, NOTIFY_PIPE);
+	}
+}
+
 /* Overview:
  *   Read at most 'n' bytes from the pipe referred by 'fd' into 'vbuf'.
  *
@@ -140,22 +171,26 @@ static int pipe_read(struct Fd *fd, void *vbuf, u_int n, u_int offset) {
 	// When the pipe buffer is empty:
 	//  - If at least 1 byte is read, or the pipe is closed, just return the number
 	//    of bytes read so far.
-	//  - Otherwise, keep yielding until the buffer isn't empty or the pipe is closed.
+	//  - Otherwise, keep waiting (see 'pipe_wait') until the buffer isn't empty or the pipe is
+	//    closed.
+	// A writer waiting for room is woken up once we have read something.
 	/* Exercise 6.1: Your code here. (2/3) */
 	p = fd2data(fd);
 	rbuf = (char *)vbuf;
 	for (i = 0; i < n; i++) {
 		while (p->p_rpos >= p->p_wpos) {
 			if (i > 0 || _pipe_is_closed(fd, p)) {
+				pipe_wakeup(&p->p_wwaiter);
 				return i;
 			} else {
-				syscall_yield();
+				pipe_wait(&p->p_rwaiter, p->p_rpos >= p->p_wpos);
 			}
 		}
 		rbuf[i] = p->p_buf[p->p_rpos % PIPE_SIZE];
 		p->p_rpos++;
 	}
-	user_panic("pipe_read not implemented");
+	pipe_wakeup(&p->p_wwaiter);
+	return n;
 }
 
 /* Overview:
@@ -180,8 +215,9 @@ static int pipe_write(struct Fd *fd, const void *vbuf, u_int n, u_int offset) {
 	// Check if the pipe is closed by '_pipe_is_closed'.
 	// When the pipe buffer is full:
 	//  - If the pipe is closed, just return the number of bytes written so far.
-	//  - If the pipe isn't closed, keep yielding until the buffer isn't full or the
-	//    pipe is closed.
+	//  - If the pipe isn't closed, keep waiting (see 'pipe_wait') until the buffer isn't full or
+	//    the pipe is closed.
+	// A reader waiting for data is woken up once we have written something.
 	/* Exercise 6.1: Your code here. (3/3) */
 	p = fd2data(fd);
 	wbuf = (char *)vbuf;
@@ -190,12 +226,14 @@ static int pipe_write(struct Fd *fd, const void *vbuf, u_int n, u_int offset) {
 			if (_pipe_is_closed(fd, p)) {
 				return i;
 			} else {
-				syscall_yield();
+				pipe_wakeup(&p->p_rwaiter);
+				pipe_wait(&p->p_wwaiter, p->p_wpos - p->p_rpos >= PIPE_SIZE);
 			}
 		}
 		p->p_buf[p->p_wpos % PIPE_SIZE] = wbuf[i];
 		p->p_wpos++;
 	}
+	pipe_wakeup(&p->p_rwaiter);
 	// user_panic("pipe_write not implemented");
 
 	return n;
@@ -237,9 +275,15 @@ int pipe_is_closed(int fdnum) {
  *   Use 'syscall_mem_unmap' to unmap the pages.
  */
 static int pipe_close(struct Fd *fd) {
+	struct Pipe *p = fd2data(fd);
+	u_int rwaiter = p->p_rwaiter, wwaiter = p->p_wwaiter;
+
 	// Unmap 'fd' and the referred Pipe.
 	syscall_mem_unmap(0, fd);
-	syscall_mem_unmap(0, (void *)fd2data(fd));
+	syscall_mem_unmap(0, (void *)p);
+	// Wake up the envs blocked on the pipe, so that they see it closed.
+	pipe_wakeup(&rwaiter);
+	pipe_wakeup(&wwaiter);
 	return 0;
 }
 
@@ -85,18 +85,16 @@ error:
 	return r;
 }
 
+// The mappings are queued with 'submit_add': a page with data is flushed together with the pages
+// queued before it, before being filled through 'UTEMP', and the others by 'spawn'.
 static int spawn_mapper(void *data, u_long va, size_t offset, u_int perm, const void *src,
 			size_t len) {
 	u_int child_id = *(u_int *)data;
-	try(syscall_mem_alloc(child_id, (void *)va, perm));
+	try(submit_add(SYS_mem_alloc, child_id, va, perm, 0, 0));
 	if (src != NULL) {
-		int r = syscall_mem_map(child_id, (void *)va, 0, (void *)UTEMP, perm | PTE_D);
-		if (r) {
-			syscall_mem_unmap(child_id, (void *)va);
-			return r;
-		}
+		try(submit_add(SYS_mem_map, child_id, va, 0, UTEMP, perm | PTE_D));
+		try(submit_flush());
 		memcpy((void *)(UTEMP + offset), src, len);
-		return syscall_mem_unmap(0, (void *)UTEMP);
 	}
 	return 0;
 }
@@ -199,12 +197,16 @@ int spawn(char *prog, char **argv) {
 			// Use 'spawn_mapper' as the callback, and '&child' as its data.
 			// 'goto err1' if that fails.
 			/* Exercise 6.4: Your code here. (6/6) */
-			if ((r = elf_load_seg(ph, bin, spawn_mapper, &child)) < 0) {
+			if ((r = elf_load_seg(ph, bin, spawn_mapper, &child)) < 0 ||
+			    (r = submit_flush()) < 0) {
 				goto err1;
 			}
 		}
 	}
 	close(fd);
+	if ((r = syscall_mem_unmap(0, (void *)UTEMP)) < 0) {
+		goto err2;
+	}
 
 	struct Trapframe tf = envs[ENVX(child)].env_tf;
 	tf.cp0_epc = entrypoint;
@@ -214,22 +216,10 @@ int spawn(char *prog, char **argv) {
 	}
 
 	// Pages with 'PTE_LIBRARY' set are shared between the parent and the child.
-	for (u_int pdeno = 0; pdeno <= PDX(USTACKTOP); pdeno++) {
-		if (!(vpd[pdeno] & PTE_V)) {
-			continue;
-		}
-		for (u_int pteno = 0; pteno <= PTX(~0); pteno++) {
-			u_int pn = (pdeno << 10) + pteno;
-			u_int perm = vpt[pn] & ((1 << PGSHIFT) - 1);
-			if ((perm & PTE_V) && (perm & PTE_LIBRARY)) {
-				void *va = (void *)(pn << PGSHIFT);
-
-				if ((r = syscall_mem_map(0, va, child, va, perm)) < 0) {
-					debugf("spawn: syscall_mem_map %x %x: %d\n", va, child, r);
-					goto err2;
-				}
-			}
-		}
+	if ((r = syscall_mem_map_range(child, (void *)UTEMP, (void *)UTEMP, VPN(USTACKTOP - UTEMP),
+				       MAP_LIBRARY)) < 0) {
+		debugf("spawn: syscall_mem_map_range %x: %d\n", child, r);
+		goto err2;
 	}
 
 	if ((r = syscall_set_env_status(child, ENV_RUNNABLE)) < 0) {
@@ -242,6 +232,7 @@ err2:
 	syscall_env_destroy(child);
 	return r;
 err1:
+	syscall_mem_unmap(0, (void *)UTEMP);
 	syscall_env_destroy(child);
 err:
 	close(fd);
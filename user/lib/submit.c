@@ -0,0 +1,64 @@
+#include <lib.h>
+#include <mmu.h>
+
+/*
+ * Syscalls queued with 'submit_add' are run in batches by 'syscall_submit', trapping into the
+ * kernel once per batch rather than once per syscall. The entries of the batch live in the page
+ * at 'SUBMITVA', which the kernel writes the results to: it is mapped with 'PTE_PRIVATE', so that
+ * 'fork' leaves it out of the child rather than making it copy-on-write, and each env allocates
+ * its own on first use.
+ */
+static u_int submit_n; // entries queued
+
+#define sqes ((struct Sqe *)SUBMITVA)
+
+/* Overview:
+ *   Queue the syscall 'sysno' with the arguments 'a1' to 'a5'. The batch is run by the next
+ *   'submit_flush', or at once if it is full.
+ *
+ * Post-Condition:
+ *   Return 0 on success, or the error of the batch run because it was full (see 'submit_flush').
+ *
+ * Hint:
+ *   Only the syscalls listed in 'syscall_batch' (in 'kern/syscall_all.c') may be queued. As
+ *   they only run later, the memory passed to them has to stay valid until then.
+ */
+int submit_add(u_int sysno, u_int a1, u_int a2, u_int a3, u_int a4, u_int a5) {
+	struct Sqe *sqe;
+
+	if (submit_n == 0 && (!(vpd[PDX(SUBMITVA)] & PTE_V) || !(vpt[VPN(SUBMITVA)] & PTE_V))) {
+		try(syscall_mem_alloc(0, (void *)SUBMITVA, PTE_D | PTE_PRIVATE));
+	}
+	sqe = &sqes[submit_n++];
+	sqe->sqe_sysno = sysno;
+	sqe->sqe_args[0] = a1;
+	sqe->sqe_args[1] = a2;
+	sqe->sqe_args[2] = a3;
+	sqe->sqe_args[3] = a4;
+	sqe->sqe_args[4] = a5;
+	if (submit_n == SQE_MAX) {
+		return submit_flush();
+	}
+	return 0;
+}
+
+/* Overview:
+ *   Run the syscalls queued so far, in order, stopping at the first one that fails.
+ *
+ * Post-Condition:
+ *   Return 0 if all of them succeeded, or else the error of the one that failed. The queue is
+ *   empty either way.
+ */
+int submit_flush(void) {
+	u_int n = submit_n;
+	int r;
+
+	if (n == 0) {
+		return 0;
+	}
+	submit_n = 0;
+	if ((r = syscall_submit(sqes, n)) < 0) {
+		return r;
+	}
+	return r < n ? sqes[r].sqe_ret : 0;
+}
@@ -105,4 +105,101 @@ int syscall_get_all_var(char *buf, int bufsize) {
 
 int syscall_get_parent_id(u_int envid) {
     return msyscall(SYS_get_parent_id, envid);
-}
\ No newline at end of file
+}
+int syscall_sleep(u_int ticks) {
+	return msyscall(SYS_sleep, ticks);
+}
+
+int syscall_ipc_recv_timed(void *dstva, u_int ticks) {
+	return msyscall(SYS_ipc_recv_timed, dstva, ticks);
+}
+
+u_int syscall_clock(void) {
+	return msyscall(SYS_clock);
+}
+
+int syscall_set_sched_param(u_int envid, u_int weight) {
+	return msyscall(SYS_set_sched_param, envid, weight);
+}
+
+int syscall_yield_to(u_int envid) {
+	return msyscall(SYS_yield_to, envid);
+}
+
+int syscall_ipc_send(u_int envid, u_int value, const void *srcva, u_int perm,
+		     const struct Ipc_msg *msg) {
+	return msyscall(SYS_ipc_send, envid, value, srcva, perm, msg);
+}
+
+int syscall_ipc_call(u_int envid, u_int value, const void *srcva, u_int perm, void *dstva,
+		     const struct Ipc_msg *msg) {
+	return msyscall(SYS_ipc_call, envid, value, srcva, perm, dstva, msg);
+}
+
+int syscall_ipc_reply_wait(u_int envid, u_int value, const void *srcva, u_int perm, void *dstva,
+			   const struct Ipc_msg *msg) {
+	return msyscall(SYS_ipc_reply_wait, envid, value, srcva, perm, dstva, msg);
+}
+
+int syscall_notify(u_int envid, u_int bits) {
+	return msyscall(SYS_notify, envid, bits);
+}
+
+u_int syscall_notify_wait(u_int mask, u_int ticks) {
+	return msyscall(SYS_notify_wait, mask, ticks);
+}
+
+int syscall_chan_create(u_int peer, u_int npages, void *va) {
+	return msyscall(SYS_chan_create, peer, npages, va);
+}
+
+int syscall_chan_attach(int chanid, void *va) {
+	return msyscall(SYS_chan_attach, chanid, va);
+}
+
+int syscall_chan_signal(int chanid, u_int bits) {
+	return msyscall(SYS_chan_signal, chanid, bits);
+}
+
+int syscall_chan_detach(int chanid) {
+	return msyscall(SYS_chan_detach, chanid);
+}
+
+int syscall_ipc_sendv(u_int envid, u_int value, const struct Ipc_page *iov, u_int npages,
+		      const struct Ipc_msg *msg) {
+	return msyscall(SYS_ipc_sendv, envid, value, iov, npages, msg);
+}
+
+int syscall_ipc_recvv(void *dstva, u_int dstpages) {
+	return msyscall(SYS_ipc_recvv, dstva, dstpages);
+}
+
+int syscall_ipc_callv(u_int envid, u_int value, const struct Ipc_msg *msg, void *dstva,
+		      u_int dstpages) {
+	return msyscall(SYS_ipc_callv, envid, value, msg, dstva, dstpages);
+}
+
+int syscall_ipc_replyv_wait(u_int envid, u_int value, const struct Ipc_page *iov, u_int npages,
+			    void *dstva) {
+	return msyscall(SYS_ipc_replyv_wait, envid, value, iov, npages, dstva);
+}
+
+int syscall_submit(struct Sqe *sqes, u_int n) {
+	return msyscall(SYS_submit, sqes, n);
+}
+
+int syscall_mem_alloc_range(u_int envid, void *va, u_int npages, u_int perm) {
+	return msyscall(SYS_mem_alloc_range, envid, va, npages, perm);
+}
+
+int syscall_mem_map_range(u_int dstid, void *srcva, void *dstva, u_int npages, u_int flags) {
+	return msyscall(SYS_mem_map_range, dstid, srcva, dstva, npages, flags);
+}
+
+int syscall_mem_unmap_range(u_int envid, void *va, u_int npages) {
+	return msyscall(SYS_mem_unmap_range, envid, va, npages);
+}
+
+int syscall_fork(void) {
+	return msyscall(SYS_fork);
+}
@@ -3,4 +3,4 @@ INITAPPS +=
 
 USERLIB	+= lib/path.o
 
-USERAPPS += touch.b mkdir.b rm.b
+USERAPPS += touch.b mkdir.b rm.b top.b
@@ -0,0 +1,157 @@
+// Show the CPU usage of each env, sorted, refreshed every few timer ticks.
+//
+// The counters are read from the per-env accounting fields of 'envs' (see include/env.h). Each
+// refresh shows what happened since the previous one. Shares are in per mille of the elapsed
+// cycles, so that 32-bit arithmetic is enough.
+
+#include <lib.h>
+
+struct Sample {
+	u_int id;	// envid the counters below belong to
+	u_int utime;	// low 32 bits of 'env_utime'
+	u_int ktime;	// low 32 bits of 'env_ktime'
+	u_int syscalls; // 'env_syscalls'
+	u_int nvcsw;	// 'env_nvcsw'
+	u_int nivcsw;	// 'env_nivcsw'
+	u_int nintr;	// 'env_nintr'
+};
+
+struct Row {
+	u_int envx;
+	struct Sample delta;
+};
+
+static struct Sample last[NENV];
+static struct Row rows[NENV];
+
+static u_int parse_uint(const char *s) {
+	u_int n = 0;
+
+	while (*s >= '0' && *s <= '9') {
+		n = n * 10 + (*s++ - '0');
+	}
+	return n;
+}
+
+static u_int busy(const struct Row *r) {
+	return r->delta.utime + r->delta.ktime;
+}
+
+// Take a sample of every live env, storing the change since the last one in 'rows'.
+// Returns the number of rows.
+static int sample(void) {
+	int i, n = 0;
+	struct Sample now, *old;
+
+	for (i = 0; i < NENV; i++) {
+		if (envs[i].env_status == ENV_FREE) {
+			continue;
+		}
+		now.id = envs[i].env_id;
+		now.utime = (u_int)envs[i].env_utime;
+		now.ktime = (u_int)envs[i].env_ktime;
+		now.syscalls = envs[i].env_syscalls;
+		now.nvcsw = envs[i].env_nvcsw;
+		now.nivcsw = envs[i].env_nivcsw;
+		now.nintr = envs[i].env_nintr;
+
+		// An env created since the last sample has its counters starting from zero.
+		old = &last[i];
+		if (old->id != now.id) {
+			memset(old, 0, sizeof(*old));
+		}
+		rows[n].envx = i;
+		rows[n].delta.id = now.id;
+		rows[n].delta.utime = now.utime - old->utime;
+		rows[n].delta.ktime = now.ktime - old->ktime;
+		rows[n].delta.syscalls = now.syscalls - old->syscalls;
+		rows[n].delta.nvcsw = now.nvcsw - old->nvcsw;
+		rows[n].delta.nivcsw = now.nivcsw - old->nivcsw;
+		rows[n].delta.nintr = now.nintr - old->nintr;
+		*old = now;
+		n++;
+	}
+	return n;
+}
+
+// Sort 'rows' by decreasing CPU time (insertion sort: there are few live envs).
+static void sort(int n) {
+	int i, j;
+	struct Row r;
+
+	for (i = 1; i < n; i++) {
+		r = rows[i];
+		for (j = i; j > 0 && busy(&rows[j - 1]) < busy(&r); j--) {
+			rows[j] = rows[j - 1];
+		}
+		rows[j] = r;
+	}
+}
+
+static void print_share(u_int cycles, u_int elapsed) {
+	u_int pm = cycles / (elapsed / 1000 ? elapsed / 1000 : 1);
+
+	printf(" %3d.%d", pm / 10, pm % 10);
+}
+
+static void show(int n, u_int elapsed) {
+	int i;
+	const volatile struct Env *e;
+
+	printf("\nENVID    PARENT   S  %%CPU  %%USR  %%SYS  SYSCALL   VCSW  IVCSW   INTR\n");
+	for (i = 0; i < n; i++) {
+		e = &envs[rows[i].envx];
+		printf("%08x %08x %c", rows[i].delta.id, e->env_parent_id,
+		       e->env_status == ENV_RUNNABLE ? 'R' : 'S');
+		print_share(busy(&rows[i]), elapsed);
+		print_share(rows[i].delta.utime, elapsed);
+		print_share(rows[i].delta.ktime, elapsed);
+		printf(" %8d %6d %6d %6d\n", rows[i].delta.syscalls, rows[i].delta.nvcsw,
+		       rows[i].delta.nivcsw, rows[i].delta.nintr);
+	}
+}
+
+void usage(void) {
+	printf("usage: top [-d ticks] [-n iterations]\n");
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	u_int delay = 100, iterations = 10, i, start, now;
+	char *arg;
+	int n;
+
+	ARGBEGIN {
+	default:
+		usage();
+	case 'd':
+		if ((arg = ARGF()) == 0) {
+			usage();
+		}
+		delay = parse_uint(arg);
+		break;
+	case 'n':
+		if ((arg = ARGF()) == 0) {
+			usage();
+		}
+		iterations = parse_uint(arg);
+		break;
+	}
+	ARGEND
+
+	if (argc != 0 || delay == 0) {
+		usage();
+	}
+
+	sample();
+	start = syscall_clock();
+	for (i = 0; iterations == 0 || i < iterations; i++) {
+		syscall_sleep(delay);
+		n = sample();
+		now = syscall_clock();
+		sort(n);
+		show(n, now - start);
+		start = now;
+	}
+	return 0;
+}